@@ -0,0 +1,67 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "MathProcessor.hpp"
+#include "Computor.hpp"
+
+// The same expressions evaluated through processCommand, which parses the
+// query and formats its answer every time, and through a Computor handle
+// compiled once and rebound before each call.
+
+#define BENCH_SCALAR_CALLS 20000
+#define BENCH_HANDLE_CALLS 4000000
+#define BENCH_MATRIX_CALLS 20000
+
+double seconds(std::chrono::steady_clock::time_point start){
+	std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+	return t.count();
+}
+
+int main(){
+	MathProcessor mp;
+	auto start = std::chrono::steady_clock::now();
+	for (int k = 0; k < BENCH_SCALAR_CALLS; k++){
+		std::string def = "x = " + std::to_string(k), query = "x^2 - 2*x + sin(x) / (1 + x) = ?";
+		mp.processCommand(def);
+		mp.processCommand(query);
+	}
+	double scalarCommand = BENCH_SCALAR_CALLS / seconds(start);
+
+	Computor c;
+	Computor::Handle f = c.compile("x^2 - 2*x + sin(x) / (1 + x)");
+	Computor::Variable x = c.variable("x");
+	ExprValue out;
+	double sum = 0;
+	start = std::chrono::steady_clock::now();
+	for (int k = 0; k < BENCH_HANDLE_CALLS; k++){
+		c.bind(x, (double)k);
+		c.evaluate(f, out);
+		sum += out.Re();
+	}
+	double scalarHandle = BENCH_HANDLE_CALLS / seconds(start);
+
+	std::string def = "m = [[2,1,0,0];[1,2,1,0];[0,1,2,1];[0,0,1,2]]", query = "m ** m + m * 2 = ?";
+	mp.processCommand(def);
+	start = std::chrono::steady_clock::now();
+	for (int k = 0; k < BENCH_MATRIX_CALLS; k++)
+		mp.processCommand(query);
+	double matrixCommand = BENCH_MATRIX_CALLS / seconds(start);
+
+	Computor::Handle g = c.compile("m ** m + m * 2");
+	ExprValue m(4, 4);
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			m(i, j) = i == j ? 2 : i - j == 1 || j - i == 1 ? 1 : 0;
+	c.bind(c.variable("m"), m);
+	start = std::chrono::steady_clock::now();
+	for (int k = 0; k < BENCH_MATRIX_CALLS; k++)
+		c.evaluate(g, out);
+	double matrixHandle = BENCH_MATRIX_CALLS / seconds(start);
+
+	std::cout << std::scientific << std::setprecision(2)
+			  << "  scalar processCommand  " << std::setw(10) << scalarCommand << " calls/s" << std::endl
+			  << "  scalar handle          " << std::setw(10) << scalarHandle << " calls/s" << std::endl
+			  << "  matrix processCommand  " << std::setw(10) << matrixCommand << " calls/s" << std::endl
+			  << "  matrix handle          " << std::setw(10) << matrixHandle << " calls/s" << std::endl
+			  << "  (checksum " << sum << ", " << out.Get(0, 0) << ")" << std::endl;
+}
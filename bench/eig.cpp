@@ -0,0 +1,50 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include "Linalg.hpp"
+
+// eig and eigvec of n x n matrices: symmetric ones by tridiagonal reduction
+// and implicit QR, general ones by Hessenberg reduction and Francis steps.
+// The residual column is max |A v - lambda v| over the symmetric vectors.
+
+template <typename F>
+double msPerRun(F f){
+	auto start = std::chrono::steady_clock::now();
+	f();
+	std::chrono::duration<double, std::milli> t = std::chrono::steady_clock::now() - start;
+	return t.count();
+}
+
+int main(){
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "  size " << std::setw(12) << "sym eig" << std::setw(12) << "sym vec" << std::setw(12) << "gen eig"
+			  << std::setw(12) << "gen vec" << "   (ms)  residual" << std::endl;
+	for (int n : {50, 100, 200, 500, 1000}){
+		std::vector<double> a((size_t)n * n), s((size_t)n * n);
+		unsigned seed = 12345;
+		for (size_t i = 0; i < a.size(); i++){
+			seed = seed * 1103515245 + 12345;
+			a[i] = (double)(seed >> 16) / 65536 - 0.5;
+		}
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++)
+				s[(size_t)i * n + j] = a[(size_t)i * n + j] + a[(size_t)j * n + i];
+		std::vector<double> wr(n), wi(n), v((size_t)n * n);
+		double t1 = msPerRun([&](){ eigenSymmetric(s.data(), n, wr.data(), NULL); });
+		double t2 = msPerRun([&](){ eigenSymmetric(s.data(), n, wr.data(), v.data()); });
+		double residual = 0;
+		for (int j = 0; j < n; j++)
+			for (int i = 0; i < n; i++){
+				double r = -wr[j] * v[(size_t)i * n + j];
+				for (int k = 0; k < n; k++)
+					r += s[(size_t)i * n + k] * v[(size_t)k * n + j];
+				residual = r > residual ? r : -r > residual ? -r : residual;
+			}
+		double t3 = msPerRun([&](){ eigenGeneral(a.data(), n, wr.data(), wi.data(), NULL); });
+		double t4 = msPerRun([&](){ eigenGeneral(a.data(), n, wr.data(), wi.data(), v.data()); });
+		std::cout << std::setw(6) << n << std::setw(12) << t1 << std::setw(12) << t2 << std::setw(12) << t3
+				  << std::setw(12) << t4 << "   " << std::scientific << std::setprecision(1) << residual
+				  << std::fixed << std::endl;
+	}
+}
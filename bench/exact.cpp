@@ -0,0 +1,46 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "ExprValue.hpp"
+#include "Bareiss.hpp"
+#include "Utils.hpp"
+
+// Determinant of n x n integer matrices: the floating-point elimination in
+// Utils against Bareiss in 64-bit and, once entries outgrow it, BigInt. The
+// det column is the builtin, which takes the exact path only while it is
+// cheap (ExprValue::isIntegral).
+
+template <typename F>
+double msPerRun(F f){
+	auto start = std::chrono::steady_clock::now();
+	f();
+	std::chrono::duration<double, std::milli> t = std::chrono::steady_clock::now() - start;
+	return t.count();
+}
+
+int main(){
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  size  entries " << std::setw(12) << "float" << std::setw(12) << "exact" << std::setw(12) << "det" << "   (ms)   digits" << std::endl;
+	for (int range : {1, 9}){
+		for (int n : {10, 50, 100, 200}){
+			std::vector<double> a((size_t)n * n);
+			unsigned seed = 12345;
+			for (size_t i = 0; i < a.size(); i++){
+				seed = seed * 1103515245 + 12345;
+				a[i] = (long long)(seed >> 16) % (2 * range + 1) - range;
+			}
+			std::vector<std::vector<double>> rows(n, std::vector<double>(n));
+			for (int i = 0; i < n; i++)
+				for (int j = 0; j < n; j++)
+					rows[i][j] = a[(size_t)i * n + j];
+			ExprValue m(n, n);
+			std::copy(a.begin(), a.end(), m.Data());
+			BigInt d;
+			double tf = msPerRun([&](){ det(rows); });
+			double te = msPerRun([&](){ d = exactDet(a.data(), n); });
+			double tb = msPerRun([&](){ m.Det(); });
+			std::cout << std::setw(6) << n << "  " << std::setw(7) << "+-" + std::to_string(range)
+					  << std::setw(12) << tf << std::setw(12) << te << std::setw(12) << tb << "   " << std::setw(8) << d.toString().size() << std::endl;
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "ExprValue.hpp"
+#include "exprnode.hpp"
+#include "FusedKernel.hpp"
+
+// a + b - c * 2 + d on n x n matrices: one ExprValue temporary per operator
+// against the fused single-pass kernel.
+
+#define BENCH_REPEATS 5
+
+exprnode *leaf(const ExprValue &v){
+	return new exprnode(v);
+}
+
+ExprValue sample(int n, int seed){
+	ExprValue m(n, n);
+	for (int i = 0; i < n * n; i++)
+		m.Data()[i] = (i * 7 + seed) % 13 - 6;
+	return m;
+}
+
+template <typename F>
+double msPerRun(F f){
+	auto start = std::chrono::steady_clock::now();
+	for (int k = 0; k < BENCH_REPEATS; k++)
+		f();
+	std::chrono::duration<double, std::milli> t = std::chrono::steady_clock::now() - start;
+	return t.count() / BENCH_REPEATS;
+}
+
+int main(){
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  size    " << std::setw(12) << "operators" << std::setw(12) << "fused" << "   (ms, a + b - c * 2 + d)" << std::endl;
+	for (int n : {100, 500, 1000, 2000}){
+		ExprValue a = sample(n, 1), b = sample(n, 2), c = sample(n, 3), d = sample(n, 4), two(2., 0.);
+		exprnode *tree = new exprnode(new exprnode(new exprnode(leaf(a), '+', leaf(b)), '-',
+												   new exprnode(leaf(c), '*', leaf(two))), '+', leaf(d));
+		FusedKernel kernel;
+		kernel.compile(tree);
+		ExprValue r1, r2;
+		double tops = msPerRun([&](){ r1 = a + b - c * two + d; });
+		double tfused = msPerRun([&](){ r2 = kernel.run(); });
+		std::cout << std::setw(6) << n << "  " << std::setw(12) << tops << std::setw(12) << tfused
+				  << (r1 == r2 ? "" : "   MISMATCH") << std::endl;
+		delete tree;
+	}
+}
@@ -0,0 +1,39 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "ExprValue.hpp"
+
+// The same products and sums on f64 and on f32 (float) matrices.
+
+#define BENCH_REPEATS 3
+
+ExprValue sample(int n, int seed){
+	ExprValue m(n, n);
+	for (int i = 0; i < n * n; i++)
+		m.Data()[i] = ((i * 7 + seed) % 13 - 6) / 8.;
+	return m;
+}
+
+template <typename F>
+double msPerRun(F f){
+	auto start = std::chrono::steady_clock::now();
+	for (int k = 0; k < BENCH_REPEATS; k++)
+		f();
+	std::chrono::duration<double, std::milli> t = std::chrono::steady_clock::now() - start;
+	return t.count() / BENCH_REPEATS;
+}
+
+int main(){
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  size  " << std::setw(12) << "** f64" << std::setw(12) << "** f32"
+			  << std::setw(12) << "+ f64" << std::setw(12) << "+ f32" << "   (ms)" << std::endl;
+	for (int n : {256, 512, 1024}){
+		ExprValue a = sample(n, 1), b = sample(n, 2), fa = a.F32(), fb = b.F32();
+		ExprValue r;
+		std::cout << std::setw(6) << n << "  "
+				  << std::setw(12) << msPerRun([&](){ r = a & b; })
+				  << std::setw(12) << msPerRun([&](){ r = fa & fb; })
+				  << std::setw(12) << msPerRun([&](){ r = a + b; })
+				  << std::setw(12) << msPerRun([&](){ r = fa + fb; }) << std::endl;
+	}
+}
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "ExprValue.hpp"
+
+// Whole-matrix, per-column and per-row sums against a plain loop, with the
+// error of each whole-matrix sum next to a long double reference.
+
+#define BENCH_REPEATS 5
+
+ExprValue sample(int n, int seed){
+	ExprValue m(n, n);
+	unsigned x = seed;
+	for (int i = 0; i < n * n; i++){
+		x = x * 1664525 + 1013904223;
+		m.Data()[i] = (x >> 8) / 16777216. * (i % 3 ? 1 : 1e6);
+	}
+	return m;
+}
+
+template <typename F>
+double msPerRun(F f){
+	auto start = std::chrono::steady_clock::now();
+	for (int k = 0; k < BENCH_REPEATS; k++)
+		f();
+	std::chrono::duration<double, std::milli> t = std::chrono::steady_clock::now() - start;
+	return t.count() / BENCH_REPEATS;
+}
+
+int main(){
+	std::cout << std::setw(6) << "size" << std::setw(12) << "loop" << std::setw(12) << "sum"
+			  << std::setw(12) << "sum(,1)" << std::setw(12) << "sum(,2)" << "   (ms)"
+			  << std::setw(14) << "loop err" << std::setw(14) << "sum err" << std::endl;
+	for (int n : {512, 1024, 2048, 4096}){
+		ExprValue a = sample(n, n);
+		const double *p = a.Data();
+		long double exact = 0;
+		for (size_t i = 0; i < (size_t)n * n; i++)
+			exact += p[i];
+		double naive = 0, s = 0;
+		ExprValue r;
+		std::cout << std::setw(6) << n << std::fixed << std::setprecision(2)
+				  << std::setw(12) << msPerRun([&](){
+						 naive = 0;
+						 for (size_t i = 0; i < (size_t)n * n; i++)
+							 naive += p[i];
+					 })
+				  << std::setw(12) << msPerRun([&](){ s = a.Sum().Re(); })
+				  << std::setw(12) << msPerRun([&](){ r = a.Sum(REDUCE_COLS); })
+				  << std::setw(12) << msPerRun([&](){ r = a.Sum(REDUCE_ROWS); }) << "        "
+				  << std::scientific << std::setprecision(2)
+				  << std::setw(14) << (double)((naive - exact) / exact)
+				  << std::setw(14) << (double)((s - exact) / exact) << std::endl;
+	}
+}
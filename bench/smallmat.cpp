@@ -0,0 +1,66 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include "ExprValue.hpp"
+#include "SmallMatrix.hpp"
+
+// Per-operation latency of matrix builtins. Sizes 2..4 go through the fixed
+// size kernels, larger ones through the generic code for comparison; the raw
+// kernel rows exclude ExprValue allocation.
+
+#define BENCH_ITERATIONS 200000
+
+volatile double sink;
+
+template <typename F>
+double nsPerOp(F f){
+	auto start = std::chrono::steady_clock::now();
+	for (int k = 0; k < BENCH_ITERATIONS; k++)
+		f(k);
+	std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+	return t.count() / BENCH_ITERATIONS;
+}
+
+ExprValue sample(int n, int seed){
+	ExprValue m(n, n);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			m(i, j) = ((i * 7 + j * 3 + seed) % 11) - 5 + (i == j ? 10 : 0);
+	return m;
+}
+
+template <int N>
+void raw(){
+	SmallMat<N> a, b, r;
+	for (int i = 0; i < N * N; i++){
+		a.m[i] = (i * 7 % 11) - 5 + (i % (N + 1) == 0 ? 10 : 0);
+		b.m[i] = (i * 3 % 7) - 3;
+	}
+	std::cout << std::setw(4) << N << "x" << N << " raw"
+			  << std::setw(10) << nsPerOp([&](int k){ a.m[0] += k & 1; smallMul<N>(a.m, b.m, r.m); sink = r.m[0]; })
+			  << std::setw(10) << nsPerOp([&](int k){ a.m[0] += k & 1; sink = smallDet<N>(a.m); })
+			  << std::setw(10) << nsPerOp([&](int k){ a.m[0] += k & 1; smallAdj<N>(a.m, r.m); sink = r.m[0]; })
+			  << std::setw(10) << nsPerOp([&](int k){ a.m[0] += k & 1; smallTrans<N>(a.m, r.m); sink = r.m[0]; })
+			  << std::setw(10) << nsPerOp([&](int k){ a.m[0] = k & 1; smallPow<N>(a.m, 5, r.m); sink = r.m[0]; })
+			  << std::endl;
+}
+
+int main(){
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "  size      " << std::setw(10) << "mul" << std::setw(10) << "det" << std::setw(10) << "inv"
+			  << std::setw(10) << "trans" << std::setw(10) << "pow5" << "   (ns/op)" << std::endl;
+	for (int n : {2, 3, 4, 5, 8}){
+		ExprValue a = sample(n, 1), b = sample(n, 2), five(5., 0.);
+		std::cout << std::setw(4) << n << "x" << n << "    "
+				  << std::setw(10) << nsPerOp([&](int){ sink = (a & b)(0, 0); })
+				  << std::setw(10) << nsPerOp([&](int){ sink = a.Det().Re(); })
+				  << std::setw(10) << nsPerOp([&](int){ sink = a.Inv()(0, 0); })
+				  << std::setw(10) << nsPerOp([&](int){ sink = a.Trans()(0, 0); })
+				  << std::setw(10) << nsPerOp([&](int){ sink = (a ^ five)(0, 0); })
+				  << std::endl;
+	}
+	raw<2>();
+	raw<3>();
+	raw<4>();
+}
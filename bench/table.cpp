@@ -0,0 +1,41 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include "MathProcessor.hpp"
+#include "Tabulate.hpp"
+
+// f over a grid: one "f(x) = ?" query per point, as scripts had to do,
+// against the table command's compiled, batched evaluation.
+
+#define BENCH_QUERIES 20000
+#define BENCH_POINTS 4000000
+
+double seconds(std::chrono::steady_clock::time_point start){
+	std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+	return t.count();
+}
+
+int main(){
+	MathProcessor mp;
+	std::string def = "f(x) = x^2 - 2*x + sin(x) / (1 + x)";
+	mp.processCommand(def);
+	auto start = std::chrono::steady_clock::now();
+	for (int k = 0; k < BENCH_QUERIES; k++){
+		std::string query = "f(" + std::to_string(k) + ") = ?";
+		mp.processCommand(query);
+	}
+	double queries = BENCH_QUERIES / seconds(start);
+
+	Expression body("x^2 - 2*x + sin(x) / (1 + x)");
+	ExprProgram f;
+	f.compile(body.getRoot(), "x");
+	std::ostringstream out;
+	start = std::chrono::steady_clock::now();
+	tabulate(f, 0, 0.25, BENCH_POINTS, out);
+	double table = BENCH_POINTS / seconds(start);
+
+	std::cout << std::scientific << std::setprecision(2)
+			  << "  queries  " << std::setw(10) << queries << " points/s" << std::endl
+			  << "  table    " << std::setw(10) << table << " points/s" << std::endl;
+}
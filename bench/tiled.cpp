@@ -0,0 +1,50 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "ExprValue.hpp"
+#include "TiledMatrix.hpp"
+
+// Operations on an n x n matrix four times the size of the memory limit, so
+// that tiles keep going through the scratch file: time and rate per operation.
+
+#define BENCH_MEMORY (8 << 20)
+#define BENCH_N 2048
+
+ExprValue sample(int n, int seed){
+	ExprValue m(n, n);
+	double *a = m.Data();
+	for (long i = 0; i < (long)n * n; i++)
+		a[i] = (i * 7 + seed) % 13 - 6 + (i % (n + 1) == 0 ? 4 * n : 0);
+	return m;
+}
+
+template <typename F>
+double msPerRun(F f){
+	auto start = std::chrono::steady_clock::now();
+	f();
+	std::chrono::duration<double, std::milli> t = std::chrono::steady_clock::now() - start;
+	return t.count();
+}
+
+void report(const char *name, double ms, double work, const char *unit){
+	std::cout << std::setw(12) << name << std::setw(12) << ms << std::setw(12) << work / ms / 1e6 << " " << unit << std::endl;
+}
+
+int main(){
+	int n = BENCH_N;
+	double bytes = (double)n * n * sizeof(double);
+	ExprValue a = sample(n, 1).Tiled(), b = sample(n, 2).Tiled(), rhs(n, 1);
+	for (int i = 0; i < n; i++)
+		rhs.Data()[i] = 1;
+	TiledMatrix::MemoryLimit limit(BENCH_MEMORY);
+	ExprValue r;
+	double rcond;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "  " << n << " x " << n << " tiled, " << bytes / BENCH_MEMORY << "x the memory limit" << std::endl;
+	std::cout << std::setw(12) << "operation" << std::setw(12) << "ms" << std::setw(12) << "rate" << std::endl;
+	report("a + b", msPerRun([&](){ r = a + b; }), 3 * bytes, "GB/s");
+	report("trans(a)", msPerRun([&](){ r = a.Trans(); }), 2 * bytes, "GB/s");
+	report("a ** b", msPerRun([&](){ r = a & b; }), 2. * n * n * n, "GFLOP/s");
+	report("det(a)", msPerRun([&](){ r = a.Det(); }), 2. * n * n * n / 3, "GFLOP/s");
+	report("solve(a, x)", msPerRun([&](){ r = a.Solve(rhs, rcond); }), 2. * n * n * n / 3, "GFLOP/s");
+}
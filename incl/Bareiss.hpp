@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "BigInt.hpp"
+
+// Exact determinant and adjugate of n x n row-major matrices whose entries
+// are all integers, by Bareiss fraction-free elimination: every division is
+// exact, so no entry is ever rounded. Elimination runs in 64-bit integers
+// with 128-bit products and carries on in BigInt from the first quotient
+// that does not fit back.
+
+bool isIntegral(const double *a, size_t n);
+int hadamardBits(const double *a, int n);
+BigInt exactDet(const double *a, int n);
+BigInt exactAdj(const double *a, int n, std::vector<BigInt> &adj);
+std::string exactString(const std::vector<BigInt> &num, const BigInt &den, int rows, int cols);
+bool isExactDouble(const BigInt &num, const BigInt &den);
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Signed integer of any size: sign and magnitude, the magnitude in 32-bit
+// words, least significant first, without leading zero words (zero has
+// none). Only what exact matrix elimination and printing need.
+class BigInt
+{
+public:
+	BigInt(long long value = 0);
+	BigInt operator+(const BigInt &rhs) const;
+	BigInt operator-(const BigInt &rhs) const;
+	BigInt operator*(const BigInt &rhs) const;
+	BigInt operator-() const;
+	bool operator==(const BigInt &rhs) const;
+	bool operator!=(const BigInt &rhs) const;
+	BigInt divExact(const BigInt &divisor) const;
+	static BigInt gcd(BigInt a, BigInt b);
+	bool isZero() const;
+	bool isNegative() const;
+	bool isPowerOfTwo() const;
+	int bits() const;
+	double toDouble() const;
+	static double ratio(const BigInt &p, const BigInt &q);
+	std::string toString() const;
+
+private:
+	typedef std::vector<uint32_t> Words;
+	static int compare(const Words &a, const Words &b);
+	static Words add(const Words &a, const Words &b);
+	static Words sub(const Words &a, const Words &b);
+	static int trailingZeros(const Words &a);
+	static Words shiftRight(const Words &a, int n);
+	void trim();
+
+	bool negative;
+	Words mag;
+};
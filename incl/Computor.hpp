@@ -0,0 +1,58 @@
+#pragma once
+#include <exception>
+#include <string>
+#include <vector>
+#include <map>
+#include "Expression.hpp"
+#include "ExprProgram.hpp"
+#include "ExprValue.hpp"
+#include "TiledMatrix.hpp"
+
+// The engine for programs linking libcomputor, without the text protocol
+// of MathProcessor. An expression is parsed and folded once by compile();
+// variables are bound by id and every evaluate() then starts from the
+// parsed tree. Expressions of real scalars also get an ExprProgram, which
+// evaluates them without touching the tree or allocating while all of
+// their variables are bound to real numbers. Matrices past the handle's
+// memory limit are kept tiled on disk.
+class Computor
+{
+public:
+	typedef int Handle;
+	typedef int Variable;
+	class UnknownHandle : public std::exception
+	{
+	public:
+		virtual const char *what() const throw();
+	};
+	class UnboundVariable : public std::exception
+	{
+	public:
+		virtual const char *what() const throw();
+	};
+
+	Computor();
+	Handle compile(const std::string &expression);
+	Variable variable(const std::string &name);
+	void bind(Variable id, const ExprValue &value);
+	void bind(Variable id, double value);
+	void setMemoryLimit(size_t bytes);
+	void evaluate(Handle handle, ExprValue &out);
+	double evaluate(Handle handle);
+
+private:
+	struct Compiled{
+		Expression expr;
+		ExprProgram program;
+		std::vector<Variable> slots;
+		std::vector<double> values;
+	};
+	Compiled &compiled(Handle handle);
+	void substitute(exprnode *root) const;
+
+	std::map<std::string, Variable> ids;
+	std::vector<ExprValue> values;
+	std::vector<char> bound;
+	std::vector<Compiled> handles;
+	size_t memory = TILED_DEFAULT_MEMORY;
+};
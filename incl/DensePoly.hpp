@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ExprValue.hpp"
+#include "exprnode.hpp"
+
+// Univariate polynomial with complex coefficients stored densely by degree
+// (separate real and imaginary arrays). Products pick schoolbook, Karatsuba
+// or FFT multiplication by size; integral inputs give exact integral output.
+class DensePoly
+{
+public:
+	DensePoly();
+	DensePoly(const ExprValue &c);
+	DensePoly(const std::vector<double> &re, const std::vector<double> &im);
+	DensePoly(const DensePoly &other);
+	DensePoly &operator=(const DensePoly &other);
+	~DensePoly();
+	static DensePoly monomial(int degree, const ExprValue &c);
+	static double powerTerms(size_t terms, long long p, double limit);
+	DensePoly operator+(const DensePoly &rhs) const;
+	DensePoly operator-(const DensePoly &rhs) const;
+	DensePoly operator*(const DensePoly &rhs) const;
+	DensePoly pow(long long p) const;
+	ExprValue operator()(const ExprValue &x) const;
+	void eval(double xre, double xim, double &re, double &im) const;
+	int degree() const;
+	ExprValue coef(int k) const;
+	const std::vector<double> &Re() const;
+	const std::vector<double> &Im() const;
+	bool isReal() const;
+	bool isFinite() const;
+	bool isIntegral() const;
+
+	static bool fromTree(const exprnode *root, DensePoly &out, std::string &varname);
+
+private:
+	void trim();
+	std::vector<double> re, im;
+};
@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+#include "exprnode.hpp"
+
+// Symbolic derivative of an evaluated tree with respect to varname. Builtins
+// without a derivative (matrix functions, unknown functions, '%', '**')
+// throw DomainError. The result is unsimplified; evaluate it to fold it.
+exprnode *derivative(const exprnode *root, const std::string &varname);
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "exprnode.hpp"
+
+// Real-valued expression of one variable, or of several given in order,
+// compiled to a postfix instruction list, so that it can be evaluated
+// repeatedly without walking the tree. Complex or matrix constants and
+// unsupported operators make compile() fail.
+class ExprProgram
+{
+public:
+	ExprProgram();
+	bool compile(const exprnode *root, const std::string &varname);
+	bool compile(const exprnode *root, const std::vector<std::string> &varnames);
+	bool isCompiled() const;
+	double operator()(double x) const;
+	double evaluate(const double *values) const;
+	void operator()(const double *x, double *y, int n) const;
+
+private:
+	enum OpCode{
+		PUSH,
+		LOAD,
+		ADD,
+		SUB,
+		MUL,
+		DIV,
+		POW,
+		CALL
+	};
+	struct Instr{
+		OpCode op;
+		double value;
+		double (*fn)(double);
+	};
+	bool emit(const exprnode *root, const std::vector<std::string> &varnames, int depth);
+
+	std::vector<Instr> code;
+	mutable std::vector<double> stack;
+};
@@ -2,6 +2,10 @@
 #include <exception>
 #include <string>
 #include <vector>
+#include <memory>
+#include "MatBuffer.hpp"
+#include "TiledMatrix.hpp"
+#include "Reduce.hpp"
 
 class ExprValue{
 public:
@@ -11,26 +15,53 @@ public:
 			return "Operands mismatch operator";
 		}
 	};
+	class SingularMatrix : public std::exception{
+	public:
+		virtual const char *what() const throw(){
+			return "Matrix is singular";
+		}
+	};
+	// Structure of square matrices, a set of bits; DIAGONAL and IDENTITY
+	// include the weaker properties they imply.
+	enum Structure{
+		GENERAL = 0,
+		SYMMETRIC = 1,
+		UPPER = 2,
+		LOWER = 4,
+		DIAGONAL = SYMMETRIC | UPPER | LOWER,
+		IDENTITY = DIAGONAL | 8
+	};
 	ExprValue();
 	ExprValue(double re, double im);
 	ExprValue(int rows, int cols);
+	ExprValue(int rows, int cols, const std::shared_ptr<MatBuffer> &buf);
+	ExprValue(const std::shared_ptr<TiledMatrix> &tiled);
+	ExprValue(int rows, int cols, const std::shared_ptr<std::vector<float>> &f32);
 	ExprValue(const ExprValue &other);
 	ExprValue &operator=(const ExprValue &other);
 	virtual ~ExprValue();
-	ExprValue operator+(const ExprValue &rhs);
-	ExprValue operator-(const ExprValue &rhs);
-	ExprValue operator*(const ExprValue &rhs);
-	ExprValue operator/(const ExprValue &rhs);
-	ExprValue operator%(const ExprValue &rhs);
-	ExprValue operator^(const ExprValue &rhs);
-	ExprValue operator&(const ExprValue &rhs);
-	bool operator==(const ExprValue &rhs);
-	bool operator!=(const ExprValue &rhs);
+	ExprValue operator+(const ExprValue &rhs) const;
+	ExprValue operator-(const ExprValue &rhs) const;
+	ExprValue operator*(const ExprValue &rhs) const;
+	ExprValue operator/(const ExprValue &rhs) const;
+	ExprValue operator%(const ExprValue &rhs) const;
+	ExprValue operator^(const ExprValue &rhs) const;
+	ExprValue operator&(const ExprValue &rhs) const;
+	bool operator==(const ExprValue &rhs) const;
+	bool operator!=(const ExprValue &rhs) const;
 	virtual std::string toString(bool tree = false) const;
 	double &operator()(int row, int col);
 	const double &operator()(int row, int col) const;
 	double Re() const;
 	double Im() const;
+	int Rows() const;
+	int Cols() const;
+	double *Data();
+	const double *Data() const;
+	const float *DataF32() const;
+	const void *Buffer() const;
+	size_t BufferBytes() const;
+	double Get(int row, int col) const;
 	ExprValue Abs() const;
 	ExprValue Sqrt() const;
 	ExprValue Exp() const;
@@ -42,21 +73,88 @@ public:
 	ExprValue Atan() const;
 	ExprValue DegToRad() const;
 	ExprValue RadToDeg() const;
-	ExprValue Det() const;
+	ExprValue Det(std::string *exact = NULL) const;
 	ExprValue Det(int fromrow, int fromcol, int n, int exceptrow, int exceptcol) const;
 	ExprValue Cof() const;
 	ExprValue Trans() const;
-	ExprValue Adj() const;
-	ExprValue Inv() const;
+	ExprValue Adj(std::string *exact = NULL) const;
+	ExprValue Inv(std::string *exact = NULL) const;
+	ExprValue Solve(const ExprValue &rhs, double &rcond) const;
+	ExprValue Eig() const;
+	ExprValue EigVec() const;
+	ExprValue Sum(int dim = REDUCE_ALL) const;
+	ExprValue Mean(int dim = REDUCE_ALL) const;
+	ExprValue Var(int dim = REDUCE_ALL) const;
+	ExprValue Min(int dim = REDUCE_ALL) const;
+	ExprValue Max(int dim = REDUCE_ALL) const;
+	ExprValue Norm(int dim = REDUCE_ALL) const;
+	ExprValue Dot(const ExprValue &rhs, int dim = REDUCE_ALL) const;
+	ExprValue Trace() const;
+	ExprValue Slice(int row, int nrows, int col, int ncols) const;
+	ExprValue Tiled() const;
+	std::shared_ptr<TiledMatrix> Tiles() const;
+	ExprValue Dense() const;
+	ExprValue F32() const;
+	ExprValue F64() const;
+	static ExprValue Concat(const std::vector<const ExprValue *> &parts, bool horizontal);
+	static ExprValue Zeros(int rows, int cols);
+	static ExprValue Ones(int rows, int cols);
+	static ExprValue Eye(int n);
+	static ExprValue Rand(int rows, int cols, long long seed);
+	static ExprValue Linspace(double from, double to, int n);
+	static ExprValue Range(double start, double step, int count);
 	bool isReal() const;
 	bool isComplex() const;
 	bool isMatrix() const;
+	bool isTiled() const;
+	bool isF32() const;
+	bool isRange() const;
+	double RangeStart() const;
+	double RangeStep() const;
+	int getStructure() const;
+	bool hasStructure(int s) const;
 
 private:
+	double at(int row, int col) const;
+	bool isContiguous() const;
+	void unshare();
+	void densify() const;
+	ExprValue combine(const ExprValue &rhs, char opcode) const;
+	ExprValue scaled(double s, char opcode) const;
+	std::vector<double> reduction(ReduceOp op, int dim, const double *center = NULL) const;
+	ExprValue reductionValue(const std::vector<double> &r, int dim, bool single) const;
+	std::vector<double> products(const ExprValue &rhs, int dim) const;
+	ExprValue map(double (*fn)(double)) const;
+	ExprValue &withStructure(int s);
+	int scanStructure() const;
+	double diagProduct() const;
+	bool isTransposeOf(const ExprValue &other) const;
+	bool isIntegral() const;
+	static ExprValue generate(int rows, int cols, const TiledMatrix::Fill &fill);
+	static bool fitsInMemory(int rows, int cols);
+	ExprValue SolveDiagonal(const ExprValue &rhs, double &rcond) const;
+
 	bool scalar;
 	double re, im;
 	int rows, cols;
-	std::vector<double> a;
+	// element (row, col) is buf->data()[offset + row * ld + col]; slices
+	// share their parent's buffer with their own offset
+	mutable std::shared_ptr<MatBuffer> buf;
+	mutable size_t offset = 0;
+	mutable int ld = 0;
+	// set instead of buf for matrices kept on disk; replaced by buf once
+	// something needs the elements in memory
+	mutable std::shared_ptr<TiledMatrix> tiled;
+	// packed elements of float (f32) matrices; buf then only caches them
+	// widened, for the operations that have no float kernel
+	std::shared_ptr<std::vector<float>> f32;
+	// row vectors rangeStart + k * rangeStep: no elements are stored until
+	// something needs them in memory, and reductions and elementwise
+	// builtins compute them as they go
+	bool range = false;
+	double rangeStart = 0, rangeStep = 0;
+	// -1 until known; any mutable element access resets it
+	mutable int structure = -1;
 };
 
 std::ostream &operator<<(std::ostream &stream, const ExprValue &value);
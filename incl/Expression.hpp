@@ -2,6 +2,7 @@
 #include <iostream>
 #include <set>
 #include <map>
+#include <vector>
 #include "exprnode.hpp"
 
 class Expression
@@ -16,6 +17,7 @@ public:
 
 	Expression();
 	Expression(const std::string& s);
+	Expression(exprnode *root);
 	Expression(const Expression &other);
 	Expression &operator=(const Expression &other);
 	~Expression();
@@ -23,11 +25,14 @@ public:
 	std::string Print() const;
 	const exprnode *getRoot() const;
 	const std::set<std::string> getVars() const;
+	const std::vector<std::string> &getNotes() const;
+	void setExplain(bool on);
 	void Reduce();
 	void Evaluate(std::map<std::string, Expression *> &defs);
 	void EvaluateRight(std::map<std::string, Expression *> &defs, const std::string &except);
 
 private:
+	exprnode *readRange();
 	exprnode *readExpression();
 	exprnode *readAddition();
 	exprnode *readFactor();
@@ -35,15 +40,28 @@ private:
 	exprnode *readConst();
 	exprnode *readMatrix();
 	exprnode *readVarFunc();
+	exprnode *readIndex(exprnode *expr);
+	exprnode *readSlice();
 	bool readDouble(double &val);
 	void collectVars();
 	void collectVars(exprnode *root);
 	void ReduceConstants(exprnode *root);
 	void recFindConstants(exprnode *root, const std::string &opcodes, std::set<exprnode *> &consts, double *total, int sign);
-	void eval(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except);
+	void eval(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except, bool fuse = true);
+	void evalLeaves(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except);
+	bool evalFused(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except);
+	bool evalChain(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except);
+	void evalFunction(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except);
+	void evalSeries(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except);
+	bool evalStreamed(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except);
+	void streamLeaves(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except);
+	void evalIntegral(exprnode *root, const std::string &except);
+	bool isResult(const exprnode *node) const;
 
 	exprnode *root;
 	std::set<std::string> vars;
+	std::vector<std::string> notes;
+	bool explain = false;
 
 	char getNextChar();
 	char getChar();
@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include "ExprValue.hpp"
+#include "exprnode.hpp"
+
+// Evaluates a maximal elementwise subtree (+ - * / over same-shaped matrices
+// and real scalars) in one pass that writes a single output buffer. The
+// subtree is compiled to three-address instructions over its constant leaves
+// and run chunk by chunk, so intermediates stay in cache-sized buffers.
+// Matrix products, powers and functions are leaves, i.e. fusion boundaries.
+class FusedKernel
+{
+public:
+	FusedKernel();
+	static bool isElementwise(const exprnode *root);
+	static int countOps(const exprnode *root);
+	bool compile(const exprnode *root);
+	ExprValue run() const;
+
+private:
+	enum OperandKind{
+		INPUT,
+		TEMP,
+		SCALAR
+	};
+	struct Operand{
+		OperandKind kind;
+		int index;
+		double value;
+	};
+	struct Instr{
+		char opcode;
+		Operand x, y;
+		int dst;
+	};
+	bool emit(const exprnode *root, int depth, Operand &res, ExprValue &scalar);
+	void runChunk(int from, int to, std::vector<double> &temps, double *out) const;
+
+	std::vector<const double *> inputs;
+	std::vector<Instr> code;
+	int rows = 0, cols = 0, ntemps = 0;
+};
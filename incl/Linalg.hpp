@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+// Dense kernels on row-major n x n arrays, shared by ExprValue and LinearSystem.
+// The templated ones are instantiated for double and float matrices.
+
+void balance(double *a, int n, double *scale = NULL);
+bool schurEigenvalues(double *a, int n, double *wr, double *wi);
+bool cholesky(double *a, int n);
+void choleskySolve(const double *l, int n, double *b, int nrhs);
+bool lu(double *a, int n, int *perm);
+void luSolve(const double *lu, int n, const int *perm, double *b, int nrhs);
+void luSolveTrans(const double *lu, int n, const int *perm, double *b);
+double norm1(const double *a, int n);
+double invNorm1(int n, const std::function<void(double *x, bool trans)> &solve);
+void hessenberg(double *a, int n, double *q);
+bool eigenGeneral(const double *a, int n, double *wr, double *wi, double *v);
+bool eigenSymmetric(const double *a, int n, double *w, double *v);
+template <typename T>
+void matmul(const T *a, const T *b, T *c, int n, int m, int p, bool symmetric);
+template <typename T>
+void elementwise(const T *a, int lda, const T *b, int ldb, T *c, int n, int m, char opcode);
+template <typename T>
+void scale(const T *a, int lda, T s, T *c, int n, int m, char opcode);
+template <typename T>
+void transpose(const T *a, int lda, T *c, int n, int m);
+bool triangularSolve(const double *t, int n, bool upper, bool trans, double *b, int nrhs);
@@ -0,0 +1,39 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include "exprnode.hpp"
+
+// System of linear equations in named variables, read from evaluated
+// equation trees in one pass each into a sparse coefficient matrix. Square
+// systems solve by the blocked dense LU, or by sparse elimination once
+// most coefficients are zero; the same elimination finds the rank of
+// singular, underdetermined and overdetermined systems.
+class LinearSystem
+{
+public:
+	LinearSystem(const std::vector<const exprnode *> &equations);
+	bool getSolved() const;
+	std::string getMsg() const;
+	const std::vector<std::string> &getNotes() const;
+	const std::vector<std::pair<std::string, double>> &getSolution() const;
+
+private:
+	typedef std::map<int, double> Row;
+
+	bool readEquation(const exprnode *eq);
+	bool readTerms(const exprnode *root, double scale, Row &row, double &constant);
+	bool realConstant(const exprnode *node);
+	bool solveDense();
+	void solveSparse();
+
+	bool _solved = false;
+	bool complex = false;
+	std::string _errmsg;
+	std::map<std::string, int> index;
+	std::vector<std::string> names;
+	std::vector<Row> rows;
+	std::vector<double> rhs;
+	std::vector<std::string> notes;
+	std::vector<std::pair<std::string, double>> solution;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Reference-counted storage of matrix elements. Copies and slices of an
+// ExprValue share one buffer; ExprValue copies it before the first write
+// while anyone else still holds it. Subclasses may point p at memory they
+// manage themselves (see MatrixFile).
+class MatBuffer
+{
+public:
+	explicit MatBuffer(size_t size);
+	MatBuffer(const double *from, size_t size);
+	explicit MatBuffer(std::vector<double> &&values);
+	virtual ~MatBuffer();
+	double *data() const;
+	size_t size() const;
+	void resize(size_t size);
+
+private:
+	MatBuffer(const MatBuffer &other);
+	MatBuffer &operator=(const MatBuffer &other);
+
+protected:
+	MatBuffer();
+
+	double *p;
+	size_t n;
+	std::vector<double> v;
+};
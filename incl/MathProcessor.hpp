@@ -2,8 +2,10 @@
 #include <iostream>
 #include <set>
 #include <map>
+#include <vector>
 #include "Expression.hpp"
 #include "exprnode.hpp"
+#include "TiledMatrix.hpp"
 
 class MathProcessor
 {
@@ -16,11 +18,26 @@ public:
 	bool isError() const;
 
 private:
+	std::string processSet(const std::string &command);
+	std::string processList() const;
+	std::string processTable(const std::string &command);
+	std::string processSystem(const std::vector<std::string> &parts);
+
 	bool error = false;
+	double bracket[2] = {-100, 100};
+	double tolerance = 1e-9;
+	bool explain = false;
+	size_t memory = TILED_DEFAULT_MEMORY;
 	std::map<std::string, Expression *> defs;
 	std::set<std::string> built_in_funcs{"abs", "sqrt", "exp", "ln", "sin",
 										 "cos", "tan", "cot", "atan", "torad",
 										 "todeg", "det", "cof", "trans", "inv",
-										 "adj"};
+										 "adj", "diff", "solve", "eig",
+										 "eigvec", "hcat", "vcat", "load",
+										 "save", "tiled", "dense", "float", "double",
+										 "sum", "mean", "var", "min", "max",
+										 "norm", "dot", "trace", "zeros", "ones",
+										 "eye", "rand", "linspace", "tabulate",
+										 "integrate", "prod"};
 	std::set<std::string> built_in_vars{"pi", "e"};
 };
@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ExprValue.hpp"
+
+// Product of a chain of matrices in the cheapest order, chosen by the classic
+// O(k^3) dynamic program over the chain dimensions. Factors must be matrices
+// with matching inner dimensions.
+class MatrixChain
+{
+public:
+	MatrixChain(const std::vector<const ExprValue *> &factors);
+	ExprValue multiply() const;
+	double cost() const;
+	double naiveCost() const;
+	std::string plan() const;
+	std::string shapes() const;
+
+private:
+	ExprValue multiply(int i, int j) const;
+	std::string plan(int i, int j) const;
+
+	std::vector<const ExprValue *> factors;
+	std::vector<int> dims;
+	std::vector<std::vector<double>> best;
+	std::vector<std::vector<int>> split;
+};
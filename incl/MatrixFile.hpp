@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "ExprValue.hpp"
+
+#define MATRIX_FILE_MAGIC "CV2M"
+
+enum MatrixDtype{
+	MATRIX_F64 = 0,
+	MATRIX_F32 = 1
+};
+
+enum MatrixLayout{
+	MATRIX_ROW_MAJOR = 0,
+	MATRIX_COL_MAJOR = 1
+};
+
+// Binary matrix file: this header, then rows * cols elements in native byte
+// order. The header is a multiple of 8 bytes so the payload stays aligned.
+struct MatrixFileHeader{
+	char magic[4];
+	uint32_t dtype;
+	uint32_t layout;
+	uint32_t reserved;
+	uint64_t rows;
+	uint64_t cols;
+};
+
+class MatrixFileError : public std::exception{
+public:
+	virtual const char *what() const throw(){
+		return "Can't read or write matrix file";
+	}
+};
+
+// Paths ending in .csv are read and written as comma separated text, one
+// matrix row per line; anything else uses the binary format, whose row-major
+// f64 payload is mapped into memory and used without a copy.
+ExprValue loadMatrix(const std::string &path);
+size_t saveMatrix(const ExprValue &m, const std::string &path);
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include "ExprProgram.hpp"
+#include "exprnode.hpp"
+
+// Real roots of a non-polynomial equation in one variable inside a bracket.
+// The bracket is sampled for sign changes and every one of them is refined
+// by Newton steps safeguarded with bisection; f' is differentiated
+// symbolically and compiled once.
+class NewtonSolver
+{
+public:
+	NewtonSolver(const exprnode *eq, const std::string &varname, double lo, double hi, double tolerance);
+	bool getSolved() const;
+	std::string getMsg() const;
+	const std::vector<std::map<double, double>> &getRoots() const;
+
+private:
+	bool refine(double a, double b, double fa, double &root) const;
+	void addroot(double x);
+
+	bool _solved = false;
+	std::string _errmsg;
+	double lo, hi, tolerance;
+	ExprProgram f, df;
+	std::vector<std::map<double, double>> roots;
+};
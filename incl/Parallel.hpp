@@ -0,0 +1,8 @@
+#pragma once
+#include <functional>
+
+// Runs body(from, to) over [begin, end) split into contiguous chunks, one per
+// hardware thread. Ranges shorter than 2 * grain run on the calling thread.
+// The body must not throw.
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body);
+int threadCount();
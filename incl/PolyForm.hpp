@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ExprValue.hpp"
+#include "exprnode.hpp"
+#include "DensePoly.hpp"
+
+// Canonical sum of monomials. A monomial is an exponent vector over the
+// atoms of an expression (variables and opaque subtrees like sin(x)),
+// trailing zero exponents trimmed so equal monomials hash equally.
+class PolyForm
+{
+public:
+	typedef std::vector<int> Monomial;
+	struct MonomialHash
+	{
+		size_t operator()(const Monomial &m) const;
+	};
+	typedef std::unordered_map<Monomial, ExprValue, MonomialHash> Terms;
+
+	class Atoms
+	{
+	public:
+		Atoms();
+		~Atoms();
+		int get(const exprnode *node);
+		const std::string &name(int id) const;
+		const exprnode *node(int id) const;
+		int size() const;
+
+	private:
+		Atoms(const Atoms &other);
+		Atoms &operator=(const Atoms &other);
+		std::vector<std::string> names;
+		std::vector<exprnode *> nodes;
+		std::unordered_map<std::string, int> ids;
+	};
+
+	PolyForm();
+	PolyForm(const ExprValue &c);
+	PolyForm(const Monomial &m, const ExprValue &c);
+	PolyForm(const PolyForm &other);
+	PolyForm &operator=(const PolyForm &other);
+	~PolyForm();
+	static PolyForm atom(int id);
+	static PolyForm fromDense(const DensePoly &d, int id);
+	PolyForm operator+(const PolyForm &rhs) const;
+	PolyForm operator-(const PolyForm &rhs) const;
+	PolyForm operator*(const PolyForm &rhs) const;
+	PolyForm pow(long long p) const;
+	bool isMonomial() const;
+	bool isConst() const;
+	bool isUnivariate(int &id) const;
+	DensePoly toDense(int id) const;
+	size_t size() const;
+	const Terms &terms() const;
+	exprnode *toTree(const Atoms &atoms) const;
+
+	static bool fromTree(const exprnode *root, PolyForm &out, Atoms &atoms);
+	static void normalize(exprnode *root);
+
+private:
+	void add(const Monomial &m, const ExprValue &c);
+	Terms t;
+};
@@ -1,8 +1,10 @@
 #pragma once
 #include "Expression.hpp"
+#include "DensePoly.hpp"
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 
 class PolySolver
 {
@@ -10,6 +12,8 @@ public:
 	PolySolver();
 	PolySolver(int ac, char **av);
 	PolySolver(std::string &eq);
+	PolySolver(const exprnode *eq);
+	PolySolver(const DensePoly &poly);
 	PolySolver(const PolySolver &other);
 	void init(std::string &eq);
 	PolySolver &operator=(const PolySolver &other);
@@ -27,9 +31,15 @@ public:
 private:
 	bool processArguments(int ac, char **av);
 	bool readEquation(std::string &s);
+	bool readPolynom(const exprnode *eq);
+	bool diagnose(const exprnode *eq);
 	bool checkDegree();
 	bool error(std::string errmsg);
 	void solve();
+	void solveAberth();
+	bool mergeClusters(const std::vector<double> &cr, const std::vector<double> &ci,
+					   std::vector<double> &zr, std::vector<double> &zi) const;
+	double residual(double re, double im) const;
 	void addroot(double re, double im);
 
 	Expression *_expr = NULL;
@@ -37,7 +47,8 @@ private:
 	bool _explanation = false;
 	std::string _errmsg;
 	long double _precision = 1e-6l;
-	std::map<double, double> polynom;
+	DensePoly poly;
+	std::string varname;
 	std::vector<std::map<double, double>> roots;
 	int deg;
 	int _digits = 6;
@@ -0,0 +1,18 @@
+#pragma once
+#include "ExprProgram.hpp"
+
+// Definite integral of a compiled function by adaptive Gauss-Kronrod
+// quadrature (7-point Gauss, 15-point Kronrod rule), error estimated as in
+// QUADPACK's qk15. The subintervals with the largest errors are bisected a
+// batch at a time, and the nodes of a whole batch go through the program's
+// batch form in one call per thread. value is NaN once f is NaN or
+// infinite at some node.
+struct Quadrature{
+	double value;
+	double error;
+	long long evaluations;
+	int intervals;
+	bool converged;
+};
+
+Quadrature integrate(const ExprProgram &f, double a, double b);
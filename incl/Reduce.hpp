@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+
+// Reductions of an n x m row-major matrix with row stride ld, over the whole
+// matrix (REDUCE_ALL, one result), down each column (REDUCE_COLS, m results)
+// or along each row (REDUCE_ROWS, n results). Sums are pairwise along rows
+// and Kahan-compensated down columns, in double whatever the element type.
+// Work is split into blocks of a fixed size, whose partial results are
+// combined in a fixed order, so results do not depend on the thread count.
+
+enum ReduceDim{
+	REDUCE_ALL = 0,
+	REDUCE_COLS = 1,
+	REDUCE_ROWS = 2
+};
+
+enum ReduceOp{
+	REDUCE_SUM,
+	// sum of (x - center)^2, center given per result
+	REDUCE_SQDEV,
+	REDUCE_MIN,
+	REDUCE_MAX
+};
+
+template <typename T>
+void reduce(const T *a, int n, int m, int ld, ReduceOp op, ReduceDim dim, const double *center, double *out);
+// op over start, start + step, ... n elements, generated as they are summed.
+void reduceSequence(double start, double step, int n, ReduceOp op, const double *center, double *out);
+template <typename T>
+void dot(const T *a, int lda, const T *b, int ldb, int n, int m, ReduceDim dim, double *out);
@@ -0,0 +1,20 @@
+#pragma once
+#include "ExprProgram.hpp"
+#include "DensePoly.hpp"
+#include "Reduce.hpp"
+
+// Sums and products of f(k) over the integers k from first to last, in
+// fixed blocks evaluated through the program's batch form and split across
+// threads. Block sums are Neumaier-compensated and then added pairwise;
+// products carry their binary exponent apart, so partial products neither
+// overflow nor underflow. Block results are combined in a fixed order, so
+// the thread count does not change the result.
+double seriesSum(const ExprProgram &f, long long first, long long last);
+double seriesProduct(const ExprProgram &f, long long first, long long last);
+// op over f(start + k * step) for k from 0 to count - 1, a block of values
+// at a time, so that memory does not grow with count; NaN if f is NaN at
+// some point, which min and max would otherwise skip.
+double sequenceReduce(const ExprProgram &f, double start, double step, long long count, ReduceOp op, double center);
+// Closed form of the sum of a polynomial with real coefficients, from its
+// forward differences at first: sum of D^j p(first) C(n, j + 1).
+double polynomialSum(const DensePoly &p, long long first, long long last);
@@ -0,0 +1,164 @@
+#pragma once
+#include <utility>
+#include <type_traits>
+
+// Kernels for 2x2, 3x3 and 4x4 matrices stored row-major in plain arrays.
+// Loop bounds are template parameters expanded by index sequences, so every
+// kernel is straight-line code and temporaries stay on the stack.
+
+template <int N>
+struct SmallMat
+{
+	double m[N * N];
+};
+
+template <int N, std::size_t... K>
+inline double smallDot(const double *a, const double *b, int i, int j, std::index_sequence<K...>){
+	return ((a[i * N + K] * b[K * N + j]) + ...);
+}
+
+template <int N, std::size_t... I>
+inline void smallMul(const double *a, const double *b, double *r, std::index_sequence<I...>){
+	((r[I] = smallDot<N>(a, b, I / N, I % N, std::make_index_sequence<N>())), ...);
+}
+
+// r must not alias a or b.
+template <int N>
+inline void smallMul(const double *a, const double *b, double *r){
+	smallMul<N>(a, b, r, std::make_index_sequence<N * N>());
+}
+
+template <int N, std::size_t... I>
+inline void smallTrans(const double *a, double *r, std::index_sequence<I...>){
+	((r[I] = a[(I % N) * N + I / N]), ...);
+}
+
+template <int N>
+inline void smallTrans(const double *a, double *r){
+	smallTrans<N>(a, r, std::make_index_sequence<N * N>());
+}
+
+template <int N>
+double smallDet(const double *a);
+
+template <>
+inline double smallDet<2>(const double *a){
+	return a[0] * a[3] - a[1] * a[2];
+}
+
+template <>
+inline double smallDet<3>(const double *a){
+	return a[0] * (a[4] * a[8] - a[5] * a[7])
+		 - a[1] * (a[3] * a[8] - a[5] * a[6])
+		 + a[2] * (a[3] * a[7] - a[4] * a[6]);
+}
+
+// 2x2 minors of the top two rows (s) and the bottom two rows (c); shared by
+// the 4x4 determinant and inverse.
+inline void smallMinors4(const double *a, double *s, double *c){
+	s[0] = a[0] * a[5] - a[4] * a[1];
+	s[1] = a[0] * a[6] - a[4] * a[2];
+	s[2] = a[0] * a[7] - a[4] * a[3];
+	s[3] = a[1] * a[6] - a[5] * a[2];
+	s[4] = a[1] * a[7] - a[5] * a[3];
+	s[5] = a[2] * a[7] - a[6] * a[3];
+	c[0] = a[8] * a[13] - a[12] * a[9];
+	c[1] = a[8] * a[14] - a[12] * a[10];
+	c[2] = a[8] * a[15] - a[12] * a[11];
+	c[3] = a[9] * a[14] - a[13] * a[10];
+	c[4] = a[9] * a[15] - a[13] * a[11];
+	c[5] = a[10] * a[15] - a[14] * a[11];
+}
+
+template <>
+inline double smallDet<4>(const double *a){
+	double s[6], c[6];
+	smallMinors4(a, s, c);
+	return s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+}
+
+// Adjugate of a; the inverse is adj / det.
+template <int N>
+void smallAdj(const double *a, double *r);
+
+template <>
+inline void smallAdj<2>(const double *a, double *r){
+	r[0] = a[3];
+	r[1] = -a[1];
+	r[2] = -a[2];
+	r[3] = a[0];
+}
+
+template <>
+inline void smallAdj<3>(const double *a, double *r){
+	r[0] = a[4] * a[8] - a[5] * a[7];
+	r[1] = a[2] * a[7] - a[1] * a[8];
+	r[2] = a[1] * a[5] - a[2] * a[4];
+	r[3] = a[5] * a[6] - a[3] * a[8];
+	r[4] = a[0] * a[8] - a[2] * a[6];
+	r[5] = a[2] * a[3] - a[0] * a[5];
+	r[6] = a[3] * a[7] - a[4] * a[6];
+	r[7] = a[1] * a[6] - a[0] * a[7];
+	r[8] = a[0] * a[4] - a[1] * a[3];
+}
+
+template <>
+inline void smallAdj<4>(const double *a, double *r){
+	double s[6], c[6];
+	smallMinors4(a, s, c);
+	r[0] = a[5] * c[5] - a[6] * c[4] + a[7] * c[3];
+	r[1] = -a[1] * c[5] + a[2] * c[4] - a[3] * c[3];
+	r[2] = a[13] * s[5] - a[14] * s[4] + a[15] * s[3];
+	r[3] = -a[9] * s[5] + a[10] * s[4] - a[11] * s[3];
+	r[4] = -a[4] * c[5] + a[6] * c[2] - a[7] * c[1];
+	r[5] = a[0] * c[5] - a[2] * c[2] + a[3] * c[1];
+	r[6] = -a[12] * s[5] + a[14] * s[2] - a[15] * s[1];
+	r[7] = a[8] * s[5] - a[10] * s[2] + a[11] * s[1];
+	r[8] = a[4] * c[4] - a[5] * c[2] + a[7] * c[0];
+	r[9] = -a[0] * c[4] + a[1] * c[2] - a[3] * c[0];
+	r[10] = a[12] * s[4] - a[13] * s[2] + a[15] * s[0];
+	r[11] = -a[8] * s[4] + a[9] * s[2] - a[11] * s[0];
+	r[12] = -a[4] * c[3] + a[5] * c[1] - a[6] * c[0];
+	r[13] = a[0] * c[3] - a[1] * c[1] + a[2] * c[0];
+	r[14] = -a[12] * s[3] + a[13] * s[1] - a[14] * s[0];
+	r[15] = a[8] * s[3] - a[9] * s[1] + a[10] * s[0];
+}
+
+// a^p for p >= 0 by repeated squaring.
+template <int N>
+inline void smallPow(const double *a, long long p, double *r){
+	SmallMat<N> x, t;
+	for (int i = 0; i < N * N; i++){
+		x.m[i] = a[i];
+		r[i] = i % (N + 1) == 0;
+	}
+	for (; p > 0; p >>= 1){
+		if (p & 1){
+			smallMul<N>(r, x.m, t.m);
+			for (int i = 0; i < N * N; i++)
+				r[i] = t.m[i];
+		}
+		if (p > 1){
+			smallMul<N>(x.m, x.m, t.m);
+			x = t;
+		}
+	}
+}
+
+// Calls f(std::integral_constant<int, n>()) when n is 2, 3 or 4; returns
+// false for every other size so the caller can take the generic path.
+template <typename F>
+inline bool dispatchSmall(int n, F f){
+	switch (n){
+	case 2:
+		f(std::integral_constant<int, 2>());
+		return true;
+	case 3:
+		f(std::integral_constant<int, 3>());
+		return true;
+	case 4:
+		f(std::integral_constant<int, 4>());
+		return true;
+	}
+	return false;
+}
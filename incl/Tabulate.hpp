@@ -0,0 +1,10 @@
+#pragma once
+#include <ostream>
+#include "ExprProgram.hpp"
+
+// Writes "x,f(x)" CSV rows for x = from + k * step, k = 0 ... count - 1;
+// points outside f's domain get "x,Domain error".
+// Points are evaluated in batches through the compiled program and
+// formatted in parallel, a fixed range of points per task, then written in
+// order in large blocks. Returns false if writing failed.
+bool tabulate(const ExprProgram &f, double from, double step, long long count, std::ostream &out);
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <functional>
+#include <vector>
+#include <sys/types.h>
+
+#define TILE 256
+#define TILED_DEFAULT_MEMORY ((size_t)1 << 30)
+
+// Matrix kept on local disk as TILE x TILE row-major tiles (edge tiles padded
+// with zeros) in an unlinked scratch file. Tiles are read through one cache
+// shared by all tiled matrices and bounded by the memory limit; dirty tiles
+// are written back when evicted. A tiled matrix is not changed once built:
+// operations, including the factorization behind det and solve, write new
+// ones.
+class TiledMatrix
+{
+public:
+	class TooLarge : public std::exception{
+	public:
+		virtual const char *what() const throw(){
+			return "Matrix does not fit in the memory limit";
+		}
+	};
+	// fill(row, col, nrows, ncols, a, ld) writes the block at (row, col)
+	// into a, with row stride ld
+	typedef std::function<void(int, int, int, int, double *, int)> Fill;
+	struct Tile{
+		std::vector<double> a;
+		bool dirty;
+	};
+
+	TiledMatrix(int rows, int cols);
+	~TiledMatrix();
+	int rows() const;
+	int cols() const;
+	int tileRows() const;
+	int tileCols() const;
+	std::shared_ptr<Tile> tile(int ti, int tj, bool write = false, bool overwrite = false) const;
+	void prefetch(int ti, int tj) const;
+	double get(int row, int col) const;
+
+	static std::shared_ptr<TiledMatrix> fromDense(const double *a, int rows, int cols);
+	static std::shared_ptr<TiledMatrix> generate(int rows, int cols, const Fill &fill);
+	static std::shared_ptr<TiledMatrix> fromFile(int fd, off_t offset, int rows, int cols);
+	void toDense(double *a) const;
+	void block(int row, int col, int nrows, int ncols, double *a) const;
+	void toFile(int fd, off_t offset) const;
+
+	std::shared_ptr<TiledMatrix> elementwise(const TiledMatrix &rhs, char opcode) const;
+	std::shared_ptr<TiledMatrix> scalarOp(double s, char opcode) const;
+	std::shared_ptr<TiledMatrix> multiply(const TiledMatrix &rhs) const;
+	std::shared_ptr<TiledMatrix> transpose() const;
+	double det() const;
+	bool solve(double *b, int nrhs, double &rcond) const;
+
+	// Matrices past the memory limit are kept tiled, and the tile cache is
+	// bounded by it. Each MathProcessor or Computor handle has its own and
+	// puts it in force with a MemoryLimit while it evaluates; outside of
+	// one the limit is TILED_DEFAULT_MEMORY.
+	class MemoryLimit{
+	public:
+		MemoryLimit(size_t bytes);
+		~MemoryLimit();
+
+	private:
+		MemoryLimit(const MemoryLimit &other);
+		MemoryLimit &operator=(const MemoryLimit &other);
+		size_t saved;
+	};
+	static size_t memoryLimit();
+
+private:
+	TiledMatrix(const TiledMatrix &other);
+	TiledMatrix &operator=(const TiledMatrix &other);
+	int width(int tj) const;
+	int height(int ti) const;
+	std::shared_ptr<TiledMatrix> copy() const;
+	bool factor(std::vector<int> &piv);
+	void luSolve(const std::vector<int> &piv, double *b, int nrhs, bool trans) const;
+	double norm1() const;
+
+	friend class TileCache;
+	void load(int index, double *a) const;
+	void store(int index, const double *a) const;
+
+	int nrows, ncols;
+	int fd;
+};
@@ -6,6 +6,7 @@
 #include <sstream>
 #define FT_PI 3.14159265358979323846
 #define FT_E 2.71828182845904523536
+#define FT_SQRT2 1.41421356237309504880
 
 class DomainError : public std::exception
 {
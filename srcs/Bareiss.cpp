@@ -0,0 +1,211 @@
+#include "Bareiss.hpp"
+#include <climits>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+#define EXACT_DOUBLE_BITS 53
+
+bool isIntegral(const double *a, size_t n){
+	for (size_t i = 0; i < n; i++)
+		if (!(a[i] > -9e18 && a[i] < 9e18) || a[i] != (double)(long long)a[i])
+			return false;
+	return true;
+}
+
+// Hadamard's bound on the bits of det(A), from |det A| <= the product of the
+// row norms; what the exact elimination has to carry is of that size.
+int hadamardBits(const double *a, int n){
+	int bits = 0;
+	for (int i = 0; i < n; i++){
+		double s = 0;
+		for (int j = 0; j < n; j++)
+			s += a[(size_t)i * n + j] * a[(size_t)i * n + j];
+		if (s == 0)
+			return 0;
+		int e;
+		std::frexp(s, &e);
+		bits += (e + 1) / 2;
+	}
+	return bits;
+}
+
+static bool isZero(long long x){
+	return x == 0;
+}
+
+static bool isZero(const BigInt &x){
+	return x.isZero();
+}
+
+// (akk aij - aik akj) / prev, exact by Sylvester's identity. In 64 bits the
+// products are taken in 128 bits and the update fails when the quotient does
+// not fit back; entries stay above LLONG_MIN so the difference cannot
+// overflow either.
+static bool update(long long akk, long long aij, long long aik, long long akj, long long prev, long long &out){
+	__int128 num = (__int128)akk * aij - (__int128)aik * akj;
+	if (num >= -LLONG_MAX && num <= LLONG_MAX){
+		out = (long long)num / prev;
+		return true;
+	}
+	num /= prev;
+	if (num < -LLONG_MAX || num > LLONG_MAX)
+		return false;
+	out = (long long)num;
+	return true;
+}
+
+static bool update(const BigInt &akk, const BigInt &aij, const BigInt &aik, const BigInt &akj, const BigInt &prev, BigInt &out){
+	out = (akk * aij - aik * akj).divExact(prev);
+	return true;
+}
+
+template <typename T>
+struct Elimination{
+	std::vector<T> a;
+	int n, m;
+	bool jordan;
+	int k, i, sign;
+	T prev;
+	bool singular;
+
+	bool run();
+};
+
+// Eliminates the n x m matrix a (m >= n) column by column, swapping rows for
+// zero pivots. Plain Bareiss elimination clears below the pivots and leaves
+// sign * det(A) as the last one; with jordan it clears above them too, which
+// turns [A | I] into [d I | d A^-1] for d = sign * det(A), that is, into
+// sign * adj(A) on the right. Each row is written only once it is complete,
+// so when a 64-bit quotient overflows, k and i tell where to go on from.
+template <typename T>
+bool Elimination<T>::run(){
+	std::vector<T> row(m);
+	for (; k < n; k++){
+		if (i < 0){
+			int p = k;
+			while (p < n && isZero(a[(size_t)p * m + k]))
+				p++;
+			if (p == n){
+				singular = true;
+				return true;
+			}
+			if (p != k){
+				std::swap_ranges(a.begin() + (size_t)p * m, a.begin() + (size_t)(p + 1) * m, a.begin() + (size_t)k * m);
+				sign = -sign;
+			}
+			i = jordan ? 0 : k + 1;
+		}
+		const T *ak = &a[(size_t)k * m];
+		for (; i < n; i++){
+			if (i == k)
+				continue;
+			T *ai = &a[(size_t)i * m];
+			for (int j = k + 1; j < m; j++)
+				if (!update(ak[k], ai[j], ai[k], ak[j], prev, row[j]))
+					return false;
+			std::copy(row.begin() + k + 1, row.end(), ai + k + 1);
+			ai[k] = 0;
+		}
+		prev = ak[k];
+		i = -1;
+	}
+	return true;
+}
+
+// Runs the elimination of a (n x m) in 64 bits, and in BigInt from the first
+// overflow on.
+static Elimination<BigInt> eliminate(const std::vector<long long> &a, int n, int m, bool jordan){
+	Elimination<long long> small = {a, n, m, jordan, 0, -1, 1, 1, false};
+	bool done = small.run();
+	Elimination<BigInt> big = {std::vector<BigInt>(small.a.begin(), small.a.end()), n, m, jordan,
+							   small.k, small.i, small.sign, small.prev, small.singular};
+	if (!done)
+		big.run();
+	return big;
+}
+
+BigInt exactDet(const double *a, int n){
+	std::vector<long long> m(a, a + (size_t)n * n);
+	Elimination<long long> small = {m, n, n, false, 0, -1, 1, 1, false};
+	if (small.run())
+		return small.singular ? BigInt() : BigInt(small.sign) * BigInt(small.a.back());
+	Elimination<BigInt> big = {std::vector<BigInt>(small.a.begin(), small.a.end()), n, n, false,
+							   small.k, small.i, small.sign, small.prev, false};
+	big.run();
+	return big.singular ? BigInt() : BigInt(big.sign) * big.a.back();
+}
+
+// Fills adj (row-major) with adj(A) and returns det(A). A regular A is
+// eliminated once as [A | I]; a singular one, whose adjugate may still be
+// non-zero, gets a determinant per cofactor.
+BigInt exactAdj(const double *a, int n, std::vector<BigInt> &adj){
+	adj.assign((size_t)n * n, BigInt());
+	if (n == 1){
+		adj[0] = 1;
+		return BigInt((long long)a[0]);
+	}
+	std::vector<long long> m((size_t)n * 2 * n, 0);
+	for (int i = 0; i < n; i++){
+		std::copy(a + (size_t)i * n, a + (size_t)(i + 1) * n, m.begin() + (size_t)i * 2 * n);
+		m[(size_t)i * 2 * n + n + i] = 1;
+	}
+	Elimination<BigInt> e = eliminate(m, n, 2 * n, true);
+	if (!e.singular){
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++)
+				adj[(size_t)i * n + j] = e.sign < 0 ? -e.a[(size_t)i * 2 * n + n + j] : e.a[(size_t)i * 2 * n + n + j];
+		BigInt d = e.a[(size_t)(n - 1) * 2 * n + n - 1];
+		return e.sign < 0 ? -d : d;
+	}
+	std::vector<double> minor((size_t)(n - 1) * (n - 1));
+	for (int row = 0; row < n; row++)
+		for (int col = 0; col < n; col++){
+			size_t k = 0;
+			for (int i = 0; i < n; i++)
+				for (int j = 0; j < n; j++)
+					if (i != row && j != col)
+						minor[k++] = a[(size_t)i * n + j];
+			BigInt c = exactDet(minor.data(), n - 1);
+			adj[(size_t)col * n + row] = (row + col) % 2 ? -c : c;
+		}
+	return BigInt();
+}
+
+// num / den, reduced, in the toString layout of a matrix: "p/q" or "p".
+std::string exactString(const std::vector<BigInt> &num, const BigInt &den, int rows, int cols){
+	std::stringstream ss;
+	for (int row = 0; row < rows; row++){
+		ss << "[ ";
+		for (int col = 0; col < cols; col++){
+			BigInt p = num[(size_t)row * cols + col], q = den;
+			BigInt g = BigInt::gcd(p, q);
+			if (!g.isZero() && g != BigInt(1)){
+				p = p.divExact(g);
+				q = q.divExact(g);
+			}
+			if (q.isNegative()){
+				p = -p;
+				q = -q;
+			}
+			ss << p.toString();
+			if (q != BigInt(1))
+				ss << "/" << q.toString();
+			ss << (col < cols - 1 ? " , " : "");
+		}
+		ss << " ]";
+		if (row < rows - 1)
+			ss << "\n  ";
+	}
+	return ss.str();
+}
+
+// Whether num / den is a double exactly: a power of two below at most
+// EXACT_DOUBLE_BITS significant bits, once reduced.
+bool isExactDouble(const BigInt &num, const BigInt &den){
+	BigInt g = BigInt::gcd(num, den);
+	if (num.isZero())
+		return true;
+	BigInt p = num.divExact(g), q = den.divExact(g);
+	return q.isPowerOfTwo() && p.bits() <= EXACT_DOUBLE_BITS;
+}
@@ -0,0 +1,266 @@
+#include "BigInt.hpp"
+#include <cmath>
+#include <algorithm>
+
+BigInt::BigInt(long long value) : negative(value < 0){
+	unsigned long long m = value < 0 ? 0ULL - (unsigned long long)value : value;
+	while (m){
+		mag.push_back((uint32_t)m);
+		m >>= 32;
+	}
+}
+
+void BigInt::trim(){
+	while (!mag.empty() && mag.back() == 0)
+		mag.pop_back();
+	if (mag.empty())
+		negative = false;
+}
+
+int BigInt::compare(const Words &a, const Words &b){
+	if (a.size() != b.size())
+		return a.size() < b.size() ? -1 : 1;
+	for (size_t i = a.size(); i-- > 0;)
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+BigInt::Words BigInt::add(const Words &a, const Words &b){
+	const Words &l = a.size() >= b.size() ? a : b, &s = a.size() >= b.size() ? b : a;
+	Words r(l.size() + 1);
+	uint64_t carry = 0;
+	for (size_t i = 0; i < l.size(); i++){
+		carry += (uint64_t)l[i] + (i < s.size() ? s[i] : 0);
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	r[l.size()] = (uint32_t)carry;
+	return r;
+}
+
+// a - b for a >= b.
+BigInt::Words BigInt::sub(const Words &a, const Words &b){
+	Words r(a.size());
+	int64_t borrow = 0;
+	for (size_t i = 0; i < a.size(); i++){
+		int64_t d = (int64_t)a[i] - (i < b.size() ? b[i] : 0) - borrow;
+		borrow = d < 0;
+		r[i] = (uint32_t)(d + (borrow << 32));
+	}
+	return r;
+}
+
+BigInt BigInt::operator+(const BigInt &rhs) const{
+	BigInt r;
+	if (negative == rhs.negative){
+		r.mag = add(mag, rhs.mag);
+		r.negative = negative;
+	}else if (compare(mag, rhs.mag) >= 0){
+		r.mag = sub(mag, rhs.mag);
+		r.negative = negative;
+	}else{
+		r.mag = sub(rhs.mag, mag);
+		r.negative = rhs.negative;
+	}
+	r.trim();
+	return r;
+}
+
+BigInt BigInt::operator-(const BigInt &rhs) const{
+	return *this + -rhs;
+}
+
+BigInt BigInt::operator-() const{
+	BigInt r = *this;
+	r.negative = !negative && !mag.empty();
+	return r;
+}
+
+BigInt BigInt::operator*(const BigInt &rhs) const{
+	BigInt r;
+	if (mag.empty() || rhs.mag.empty())
+		return r;
+	r.mag.assign(mag.size() + rhs.mag.size(), 0);
+	for (size_t i = 0; i < mag.size(); i++){
+		uint64_t carry = 0;
+		for (size_t j = 0; j < rhs.mag.size(); j++){
+			carry += (uint64_t)mag[i] * rhs.mag[j] + r.mag[i + j];
+			r.mag[i + j] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		r.mag[i + rhs.mag.size()] = (uint32_t)carry;
+	}
+	r.negative = negative != rhs.negative;
+	r.trim();
+	return r;
+}
+
+bool BigInt::operator==(const BigInt &rhs) const{
+	return negative == rhs.negative && mag == rhs.mag;
+}
+
+bool BigInt::operator!=(const BigInt &rhs) const{
+	return !(*this == rhs);
+}
+
+int BigInt::trailingZeros(const Words &a){
+	int n = 0;
+	size_t i = 0;
+	while (i < a.size() && a[i] == 0){
+		n += 32;
+		i++;
+	}
+	if (i < a.size())
+		n += __builtin_ctz(a[i]);
+	return n;
+}
+
+BigInt::Words BigInt::shiftRight(const Words &a, int n){
+	size_t words = n / 32;
+	int bits = n % 32;
+	if (words >= a.size())
+		return Words();
+	Words r(a.size() - words);
+	for (size_t i = 0; i < r.size(); i++){
+		uint64_t w = a[i + words];
+		if (bits && i + words + 1 < a.size())
+			w |= (uint64_t)a[i + words + 1] << 32;
+		r[i] = (uint32_t)(w >> bits);
+	}
+	return r;
+}
+
+// This / divisor when the division is known to leave no remainder, as in
+// fraction-free elimination. Works up from the lowest word: with an odd
+// divisor d each quotient word is the current low word times d^-1 mod 2^32,
+// so no trial division is needed. Powers of two are shifted out first.
+BigInt BigInt::divExact(const BigInt &divisor) const{
+	BigInt q;
+	if (mag.empty())
+		return q;
+	int shift = trailingZeros(divisor.mag);
+	Words d = shiftRight(divisor.mag, shift), r = shiftRight(mag, shift);
+	uint32_t inv = d[0];
+	for (int i = 0; i < 4; i++)
+		inv *= 2 - d[0] * inv;
+	if (r.size() < d.size())
+		return q;
+	q.mag.assign(r.size() - d.size() + 1, 0);
+	for (size_t i = 0; i < q.mag.size(); i++){
+		uint32_t qi = r[i] * inv;
+		q.mag[i] = qi;
+		if (!qi)
+			continue;
+		uint64_t carry = 0;
+		int64_t borrow = 0;
+		for (size_t j = 0; i + j < r.size(); j++){
+			if (j < d.size())
+				carry += (uint64_t)qi * d[j];
+			else if (!carry && !borrow)
+				break;
+			int64_t t = (int64_t)r[i + j] - (uint32_t)carry - borrow;
+			carry >>= 32;
+			borrow = t < 0;
+			r[i + j] = (uint32_t)(t + (borrow << 32));
+		}
+	}
+	q.negative = negative != divisor.negative;
+	q.trim();
+	return q;
+}
+
+// Binary gcd, always non-negative.
+BigInt BigInt::gcd(BigInt a, BigInt b){
+	a.negative = b.negative = false;
+	if (a.mag.empty())
+		return b;
+	if (b.mag.empty())
+		return a;
+	int za = trailingZeros(a.mag), zb = trailingZeros(b.mag), shift = std::min(za, zb);
+	a.mag = shiftRight(a.mag, za);
+	b.mag = shiftRight(b.mag, zb);
+	while (!b.mag.empty()){
+		if (compare(a.mag, b.mag) > 0)
+			std::swap(a.mag, b.mag);
+		b.mag = sub(b.mag, a.mag);
+		b.trim();
+		if (!b.mag.empty())
+			b.mag = shiftRight(b.mag, trailingZeros(b.mag));
+	}
+	// a * 2^shift
+	Words low(shift / 32, 0);
+	low.insert(low.end(), a.mag.begin(), a.mag.end());
+	a.mag = low;
+	for (int i = 0; i < shift % 32; i++)
+		a = a + a;
+	return a;
+}
+
+bool BigInt::isZero() const{
+	return mag.empty();
+}
+
+bool BigInt::isNegative() const{
+	return negative;
+}
+
+bool BigInt::isPowerOfTwo() const{
+	return !mag.empty() && bits() == trailingZeros(mag) + 1;
+}
+
+int BigInt::bits() const{
+	if (mag.empty())
+		return 0;
+	return (mag.size() - 1) * 32 + 32 - __builtin_clz(mag.back());
+}
+
+double BigInt::toDouble() const{
+	double r = 0;
+	for (size_t i = mag.size(); i-- > 0;)
+		r = r * 4294967296.0 + mag[i];
+	return negative ? -r : r;
+}
+
+// p / q as a double, also when p and q themselves are out of double range.
+double BigInt::ratio(const BigInt &p, const BigInt &q){
+	if (p.isZero())
+		return 0;
+	int shift = std::max(0, std::max(p.bits(), q.bits()) - 960);
+	BigInt a, b;
+	a.mag = shiftRight(p.mag, shift);
+	b.mag = shiftRight(q.mag, shift);
+	a.negative = p.negative && !a.mag.empty();
+	if (b.mag.empty()){
+		// q is negligible next to p
+		double r = std::ldexp(1., 1024);
+		return p.negative != q.negative ? -r : r;
+	}
+	double r = a.toDouble() / b.toDouble();
+	return q.negative ? -r : r;
+}
+
+std::string BigInt::toString() const{
+	if (mag.empty())
+		return "0";
+	Words m = mag;
+	std::string digits;
+	while (!m.empty()){
+		uint64_t rem = 0;
+		for (size_t i = m.size(); i-- > 0;){
+			uint64_t cur = (rem << 32) | m[i];
+			m[i] = (uint32_t)(cur / 1000000000);
+			rem = cur % 1000000000;
+		}
+		while (!m.empty() && m.back() == 0)
+			m.pop_back();
+		for (int i = 0; i < 9 && (!m.empty() || rem); i++){
+			digits += (char)('0' + rem % 10);
+			rem /= 10;
+		}
+	}
+	if (negative)
+		digits += '-';
+	std::reverse(digits.begin(), digits.end());
+	return digits;
+}
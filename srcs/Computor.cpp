@@ -0,0 +1,121 @@
+#include "Computor.hpp"
+#include "Utils.hpp"
+
+const char *Computor::UnknownHandle::what() const throw()
+{
+	return "Unknown handle";
+}
+
+const char *Computor::UnboundVariable::what() const throw()
+{
+	return "Variable is not bound";
+}
+
+Computor::Computor(){}
+
+// Parses the expression and folds what does not depend on its variables;
+// errors of the text or of its constant parts are thrown here, once.
+Computor::Handle Computor::compile(const std::string &expression){
+	TiledMatrix::MemoryLimit limit(memory);
+	Compiled c;
+	c.expr = Expression(expression);
+	if (c.expr.getRoot()->opcode == '=')
+		throw Expression::IncorrectExpression();
+	std::map<std::string, Expression *> nodefs;
+	c.expr.Evaluate(nodefs);
+	std::vector<std::string> names;
+	for (const std::string &name : c.expr.getVars()){
+		names.push_back(name);
+		c.slots.push_back(variable(name));
+	}
+	c.values.resize(names.size());
+	c.program.compile(c.expr.getRoot(), names);
+	handles.push_back(c);
+	return handles.size() - 1;
+}
+
+// The id of a variable, the same for every expression that uses the name.
+Computor::Variable Computor::variable(const std::string &name){
+	std::string key = name;
+	lower(key);
+	auto it = ids.find(key);
+	if (it != ids.end())
+		return it->second;
+	ids[key] = values.size();
+	values.push_back(ExprValue());
+	bound.push_back(false);
+	return values.size() - 1;
+}
+
+void Computor::bind(Variable id, const ExprValue &value){
+	if (id < 0 || id >= (int)values.size())
+		throw UnboundVariable();
+	values[id] = value;
+	bound[id] = true;
+}
+
+void Computor::bind(Variable id, double value){
+	bind(id, ExprValue(value, 0.));
+}
+
+void Computor::setMemoryLimit(size_t bytes){
+	memory = bytes;
+}
+
+Computor::Compiled &Computor::compiled(Handle handle){
+	if (handle < 0 || handle >= (int)handles.size())
+		throw UnknownHandle();
+	return handles[handle];
+}
+
+// Bound variables become constants in a copy of the tree.
+void Computor::substitute(exprnode *root) const{
+	if (!root)
+		return;
+	if (root->opcode == 'v' && ids.count(root->varname) && bound[ids.at(root->varname)]){
+		root->opcode = 'c';
+		root->value = values[ids.at(root->varname)];
+		root->varname.clear();
+	}
+	substitute(root->left);
+	substitute(root->right);
+}
+
+// Through the compiled program when every variable holds a real number and
+// the result is a finite one; otherwise, and to report the error behind an
+// infinity or a NaN, through the ordinary evaluation of a copy of the tree.
+void Computor::evaluate(Handle handle, ExprValue &out){
+	TiledMatrix::MemoryLimit limit(memory);
+	Compiled &c = compiled(handle);
+	bool real = c.program.isCompiled();
+	for (size_t k = 0; k < c.slots.size(); k++){
+		const ExprValue &v = values[c.slots[k]];
+		if (!bound[c.slots[k]])
+			throw UnboundVariable();
+		real = real && v.isReal();
+		c.values[k] = v.Re();
+	}
+	if (real){
+		double r = c.program.evaluate(c.values.data());
+		if (r - r == 0){
+			out = ExprValue(r, 0.);
+			return;
+		}
+	}
+	exprnode *root = c.expr.getRoot()->clone();
+	substitute(root);
+	Expression e(root);
+	std::map<std::string, Expression *> nodefs;
+	e.Evaluate(nodefs);
+	if (e.getRoot()->opcode != 'c')
+		throw UnboundVariable();
+	out = e.getRoot()->value;
+}
+
+double Computor::evaluate(Handle handle){
+	ExprValue r;
+	evaluate(handle, r);
+	if (!r.isReal())
+		throw ExprValue::InvalidOperand();
+	return r.Re();
+}
@@ -0,0 +1,425 @@
+#include "DensePoly.hpp"
+#include "Utils.hpp"
+
+#define KARATSUBA_CUTOFF 32
+#define FFT_CUTOFF 512
+#define DENSEPOLY_MAX_DEGREE (1 << 24)
+#define DENSEPOLY_SPARSE_DEGREE (1 << 16)
+#define DENSEPOLY_SPARSE_RATIO 16
+
+DensePoly::DensePoly(){}
+
+DensePoly::DensePoly(const ExprValue &c) : re(1, c.Re()), im(1, c.Im()){
+	trim();
+}
+
+DensePoly::DensePoly(const std::vector<double> &re, const std::vector<double> &im) : re(re), im(im){
+	this->im.resize(this->re.size(), 0.);
+	trim();
+}
+
+DensePoly::DensePoly(const DensePoly &other) : re(other.re), im(other.im){}
+
+DensePoly &DensePoly::operator=(const DensePoly &other){
+	if (this == &other)
+		return (*this);
+	re = other.re;
+	im = other.im;
+	return (*this);
+}
+
+DensePoly::~DensePoly(){}
+
+DensePoly DensePoly::monomial(int degree, const ExprValue &c){
+	DensePoly r;
+	r.re.assign(degree + 1, 0.);
+	r.im.assign(degree + 1, 0.);
+	r.re[degree] = c.Re();
+	r.im[degree] = c.Im();
+	r.trim();
+	return r;
+}
+
+// The number of products of p terms of a polynomial with the given number
+// of terms, C(p + terms - 1, terms - 1): the terms of its p-th power when
+// no two products share a degree. Counting stops once it passes limit.
+double DensePoly::powerTerms(size_t terms, long long p, double limit){
+	double c = 1;
+	for (size_t j = 1; j < terms && c <= limit; j++)
+		c = c * (p + j) / j;
+	return c;
+}
+
+void DensePoly::trim(){
+	while (!re.empty() && re.back() == 0 && im.back() == 0){
+		re.pop_back();
+		im.pop_back();
+	}
+}
+
+int DensePoly::degree() const{
+	return (int)re.size() - 1;
+}
+
+ExprValue DensePoly::coef(int k) const{
+	if (k < 0 || k >= (int)re.size())
+		return ExprValue();
+	return ExprValue(re[k], im[k]);
+}
+
+const std::vector<double> &DensePoly::Re() const{
+	return re;
+}
+
+const std::vector<double> &DensePoly::Im() const{
+	return im;
+}
+
+bool DensePoly::isReal() const{
+	for (double v : im)
+		if (v != 0)
+			return false;
+	return true;
+}
+
+bool DensePoly::isFinite() const{
+	for (size_t k = 0; k < re.size(); k++)
+		if (re[k] - re[k] != 0 || im[k] - im[k] != 0)
+			return false;
+	return true;
+}
+
+bool DensePoly::isIntegral() const{
+	for (size_t k = 0; k < re.size(); k++)
+		if (im[k] != 0 || re[k] != (double)(long long)re[k])
+			return false;
+	return true;
+}
+
+DensePoly DensePoly::operator+(const DensePoly &rhs) const{
+	DensePoly r(re.size() >= rhs.re.size() ? *this : rhs);
+	const DensePoly &s = re.size() >= rhs.re.size() ? rhs : *this;
+	for (size_t k = 0; k < s.re.size(); k++){
+		r.re[k] += s.re[k];
+		r.im[k] += s.im[k];
+	}
+	r.trim();
+	return r;
+}
+
+DensePoly DensePoly::operator-(const DensePoly &rhs) const{
+	DensePoly r(*this);
+	if (r.re.size() < rhs.re.size()){
+		r.re.resize(rhs.re.size(), 0.);
+		r.im.resize(rhs.re.size(), 0.);
+	}
+	for (size_t k = 0; k < rhs.re.size(); k++){
+		r.re[k] -= rhs.re[k];
+		r.im[k] -= rhs.im[k];
+	}
+	r.trim();
+	return r;
+}
+
+// out[0 .. n+m-1) += a * b
+void mulSchoolbook(const double *a, int n, const double *b, int m, double *out){
+	for (int i = 0; i < n; i++){
+		double ai = a[i];
+		if (ai == 0)
+			continue;
+		for (int j = 0; j < m; j++)
+			out[i + j] += ai * b[j];
+	}
+}
+
+// out[0 .. 2n-1) = a * b, both of length n
+void mulKaratsuba(const double *a, const double *b, int n, double *out){
+	if (n < KARATSUBA_CUTOFF){
+		for (int k = 0; k < 2 * n - 1; k++)
+			out[k] = 0;
+		mulSchoolbook(a, n, b, n, out);
+		return;
+	}
+	int h = n / 2, hi = n - h;
+	std::vector<double> z0(2 * h - 1), z1(2 * hi - 1), z2(2 * hi - 1), sa(hi), sb(hi);
+	mulKaratsuba(a, b, h, z0.data());
+	mulKaratsuba(a + h, b + h, hi, z2.data());
+	for (int k = 0; k < hi; k++){
+		sa[k] = a[h + k] + (k < h ? a[k] : 0);
+		sb[k] = b[h + k] + (k < h ? b[k] : 0);
+	}
+	mulKaratsuba(sa.data(), sb.data(), hi, z1.data());
+	for (int k = 0; k < 2 * h - 1; k++)
+		z1[k] -= z0[k];
+	for (int k = 0; k < 2 * hi - 1; k++)
+		z1[k] -= z2[k];
+	for (int k = 0; k < 2 * n - 1; k++)
+		out[k] = 0;
+	for (int k = 0; k < 2 * h - 1; k++)
+		out[k] += z0[k];
+	for (int k = 0; k < 2 * hi - 1; k++){
+		out[k + h] += z1[k];
+		out[k + 2 * h] += z2[k];
+	}
+}
+
+// out[0 .. n+m-1) += a * b, splitting the longer operand into square blocks
+void mulExact(const double *a, int n, const double *b, int m, double *out){
+	if (n < m){
+		std::swap(a, b);
+		std::swap(n, m);
+	}
+	if (m < KARATSUBA_CUTOFF){
+		mulSchoolbook(a, n, b, m, out);
+		return;
+	}
+	std::vector<double> tmp(2 * m - 1);
+	for (int o = 0; o < n; o += m){
+		int len = min(m, n - o);
+		if (len < m){
+			mulExact(b, m, a + o, len, out + o);
+			continue;
+		}
+		mulKaratsuba(a + o, b, m, tmp.data());
+		for (int k = 0; k < 2 * m - 1; k++)
+			out[o + k] += tmp[k];
+	}
+}
+
+// In-place iterative radix-2 transform. Twiddles are laid out per stage:
+// w[half + j] = exp(-2*pi*i*j/len), so every stage reads them contiguously.
+void fft(std::vector<double> &xr, std::vector<double> &xi,
+		 const std::vector<double> &wr, const std::vector<double> &wi, bool inverse){
+	size_t n = xr.size();
+	for (size_t i = 1, j = 0; i < n; i++){
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j){
+			std::swap(xr[i], xr[j]);
+			std::swap(xi[i], xi[j]);
+		}
+	}
+	double sign = inverse ? -1 : 1;
+	for (size_t half = 1; half < n; half <<= 1){
+		const double *cr = wr.data() + half, *ci = wi.data() + half;
+		for (size_t i = 0; i < n; i += 2 * half){
+			double *ur = xr.data() + i, *ui = xi.data() + i;
+			double *vr = ur + half, *vi = ui + half;
+			for (size_t j = 0; j < half; j++){
+				double tr = vr[j] * cr[j] - vi[j] * sign * ci[j];
+				double ti = vr[j] * sign * ci[j] + vi[j] * cr[j];
+				vr[j] = ur[j] - tr;
+				vi[j] = ui[j] - ti;
+				ur[j] += tr;
+				ui[j] += ti;
+			}
+		}
+	}
+	if (inverse)
+		for (size_t i = 0; i < n; i++){
+			xr[i] /= n;
+			xi[i] /= n;
+		}
+}
+
+// The last stage is built from exactly computed power-of-two angles so the
+// error grows with the bit count of the index, not with the index itself;
+// earlier stages are subsamples of the next one.
+void twiddles(size_t n, std::vector<double> &wr, std::vector<double> &wi){
+	wr.assign(n > 1 ? n : 2, 1.);
+	wi.assign(wr.size(), 0.);
+	size_t half = wr.size() / 2;
+	double *tr = wr.data() + half, *ti = wi.data() + half;
+	for (size_t k = 1; k < half; k <<= 1){
+		tr[k] = cos(FT_PI * k / half);
+		ti[k] = -sin(FT_PI * k / half);
+	}
+	for (size_t k = 3; k < half; k++){
+		size_t low = k & (~k + 1), rest = k - low;
+		if (!rest)
+			continue;
+		tr[k] = tr[rest] * tr[low] - ti[rest] * ti[low];
+		ti[k] = tr[rest] * ti[low] + ti[rest] * tr[low];
+	}
+	for (size_t h = half / 2; h > 0; h >>= 1)
+		for (size_t j = 0; j < h; j++){
+			wr[h + j] = wr[2 * h + 2 * j];
+			wi[h + j] = wi[2 * h + 2 * j];
+		}
+}
+
+double maxAbs(const std::vector<double> &v){
+	double r = 0;
+	for (double x : v)
+		if (abs(x) > r)
+			r = abs(x);
+	return r;
+}
+
+DensePoly fftMultiply(const DensePoly &a, const DensePoly &b, bool round){
+	size_t len = a.Re().size() + b.Re().size() - 1, n = 1;
+	while (n < len)
+		n <<= 1;
+	std::vector<double> wr, wi;
+	twiddles(n, wr, wi);
+	std::vector<double> rr(len), ri(len, 0.);
+	if (a.isReal() && b.isReal()){
+		// pack both real inputs into one complex transform
+		std::vector<double> cr(n, 0.), ci(n, 0.);
+		std::copy(a.Re().begin(), a.Re().end(), cr.begin());
+		std::copy(b.Re().begin(), b.Re().end(), ci.begin());
+		fft(cr, ci, wr, wi, false);
+		std::vector<double> pr(n), pi(n);
+		for (size_t k = 0; k < n; k++){
+			size_t j = (n - k) & (n - 1);
+			double xr = cr[k], xi = ci[k], yr = cr[j], yi = -ci[j];
+			double sr = xr * xr - xi * xi - (yr * yr - yi * yi);
+			double si = 2 * xr * xi - 2 * yr * yi;
+			pr[k] = si / 4;
+			pi[k] = -sr / 4;
+		}
+		fft(pr, pi, wr, wi, true);
+		for (size_t k = 0; k < len; k++)
+			rr[k] = pr[k];
+	}else{
+		std::vector<double> ar(n, 0.), ai(n, 0.), br(n, 0.), bi(n, 0.);
+		std::copy(a.Re().begin(), a.Re().end(), ar.begin());
+		std::copy(a.Im().begin(), a.Im().end(), ai.begin());
+		std::copy(b.Re().begin(), b.Re().end(), br.begin());
+		std::copy(b.Im().begin(), b.Im().end(), bi.begin());
+		fft(ar, ai, wr, wi, false);
+		fft(br, bi, wr, wi, false);
+		for (size_t k = 0; k < n; k++){
+			double tr = ar[k] * br[k] - ai[k] * bi[k];
+			ai[k] = ar[k] * bi[k] + ai[k] * br[k];
+			ar[k] = tr;
+		}
+		fft(ar, ai, wr, wi, true);
+		for (size_t k = 0; k < len; k++){
+			rr[k] = ar[k];
+			ri[k] = ai[k];
+		}
+	}
+	if (round)
+		for (size_t k = 0; k < len; k++)
+			rr[k] = (double)(long long)(rr[k] + (rr[k] < 0 ? -0.5 : 0.5));
+	return DensePoly(rr, ri);
+}
+
+DensePoly DensePoly::operator*(const DensePoly &rhs) const{
+	if (re.empty() || rhs.re.empty())
+		return DensePoly();
+	int n = re.size(), m = rhs.re.size();
+	if (min(n, m) >= FFT_CUTOFF){
+		if (!isIntegral() || !rhs.isIntegral())
+			return fftMultiply(*this, rhs, false);
+		double log2n = 0;
+		for (int k = n + m; k > 1; k >>= 1)
+			log2n++;
+		// rounding is only trusted while the transform error stays well below 1/2
+		if (maxAbs(re) * maxAbs(rhs.re) * min(n, m) * log2n * 1e-15 < 0.05)
+			return fftMultiply(*this, rhs, true);
+	}
+	std::vector<double> rr(n + m - 1, 0.), ri(n + m - 1, 0.);
+	bool lreal = isReal(), rreal = rhs.isReal();
+	mulExact(re.data(), n, rhs.re.data(), m, rr.data());
+	if (!lreal && !rreal){
+		std::vector<double> t(n + m - 1, 0.);
+		mulExact(im.data(), n, rhs.im.data(), m, t.data());
+		for (int k = 0; k < n + m - 1; k++)
+			rr[k] -= t[k];
+	}
+	if (!rreal)
+		mulExact(re.data(), n, rhs.im.data(), m, ri.data());
+	if (!lreal)
+		mulExact(im.data(), n, rhs.re.data(), m, ri.data());
+	return DensePoly(rr, ri);
+}
+
+// Stops at the first square that is no longer finite and returns it, so
+// callers checking isFinite() do not wait for the rest of a hopeless power.
+DensePoly DensePoly::pow(long long p) const{
+	DensePoly r(ExprValue(1., 0.));
+	DensePoly x(*this);
+	for (; p > 0; p >>= 1){
+		if (p & 1)
+			r = r * x;
+		if (p > 1){
+			x = x * x;
+			if (!x.isFinite())
+				return x;
+		}
+	}
+	return r;
+}
+
+void DensePoly::eval(double xre, double xim, double &rre, double &rim) const{
+	rre = 0;
+	rim = 0;
+	for (int k = degree(); k >= 0; k--){
+		double t = rre * xre - rim * xim + re[k];
+		rim = rre * xim + rim * xre + im[k];
+		rre = t;
+	}
+}
+
+ExprValue DensePoly::operator()(const ExprValue &x) const{
+	double r, i;
+	eval(x.Re(), x.Im(), r, i);
+	return ExprValue(r, i);
+}
+
+bool DensePoly::fromTree(const exprnode *root, DensePoly &out, std::string &varname){
+	DensePoly l, r;
+	switch (root->opcode){
+	case 'c':
+		if (!root->value.isComplex())
+			return false;
+		out = DensePoly(root->value);
+		return true;
+	case 'v':
+		if (!varname.empty() && varname != root->varname)
+			return false;
+		varname = root->varname;
+		out = monomial(1, ExprValue(1., 0.));
+		return true;
+	case '+':
+	case '-':
+	case '*':
+		if (!fromTree(root->left, l, varname) || !fromTree(root->right, r, varname))
+			return false;
+		out = root->opcode == '+' ? l + r : root->opcode == '-' ? l - r : l * r;
+		return out.isFinite();
+	case '/':
+		if (!fromTree(root->left, l, varname) || !fromTree(root->right, r, varname) ||
+			r.degree() != 0)
+			return false;
+		out = l * DensePoly(ExprValue(1., 0.) / r.coef(0));
+		return out.isFinite();
+	case '^':
+		if (root->right->opcode != 'c' || !root->right->value.isReal() ||
+			root->right->value.Re() < 0 ||
+			root->right->value.Re() != (double)(long long)root->right->value.Re() ||
+			!fromTree(root->left, l, varname))
+			return false;
+		if (l.degree() > 0 && root->right->value.Re() * l.degree() > DENSEPOLY_MAX_DEGREE)
+			return false;
+		// large powers of sparse polynomials, x^4000000 or (x^1000 + 1)^100,
+		// are left to the sparse form instead of filling dense arrays
+		if (l.degree() * (long long)root->right->value.Re() > DENSEPOLY_SPARSE_DEGREE){
+			size_t terms = 0;
+			for (int k = 0; k <= l.degree(); k++)
+				terms += l.re[k] != 0 || l.im[k] != 0;
+			long long degree = l.degree() * (long long)root->right->value.Re();
+			if (powerTerms(terms, (long long)root->right->value.Re(), degree) * DENSEPOLY_SPARSE_RATIO < degree)
+				return false;
+		}
+		// coefficients past the double range, or the NaNs an overflowing
+		// product leaves, reject the power rather than print garbage
+		out = l.pow((long long)root->right->value.Re());
+		return out.isFinite();
+	}
+	return false;
+}
@@ -0,0 +1,108 @@
+#include "Derivative.hpp"
+#include "Utils.hpp"
+
+bool dependsOn(const exprnode *root, const std::string &varname){
+	if (!root)
+		return false;
+	if (root->opcode == 'v' && root->varname == varname)
+		return true;
+	return dependsOn(root->left, varname) || dependsOn(root->right, varname);
+}
+
+exprnode *constNode(double val){
+	return new exprnode(ExprValue(val, 0.));
+}
+
+exprnode *opNode(exprnode *left, char opcode, exprnode *right){
+	return new exprnode(left, opcode, right);
+}
+
+exprnode *callNode(const std::string &name, exprnode *arg){
+	exprnode *f = new exprnode('f', name);
+	f->left = arg;
+	return f;
+}
+
+exprnode *buildDerivative(const exprnode *root, const std::string &varname);
+
+// d/dx f(u) = f'(u) * du, written as du / g(u) where f'(u) = 1 / g(u)
+exprnode *chain(const exprnode *root, const std::string &varname){
+	const exprnode *u = root->left;
+	const std::string &f = root->varname;
+	exprnode *du = buildDerivative(u, varname);
+	if (f == "abs")
+		return opNode(opNode(u->clone(), '*', du), '/', callNode("abs", u->clone()));
+	if (f == "sqrt")
+		return opNode(du, '/', opNode(constNode(2), '*', callNode("sqrt", u->clone())));
+	if (f == "exp")
+		return opNode(callNode("exp", u->clone()), '*', du);
+	if (f == "ln")
+		return opNode(du, '/', u->clone());
+	if (f == "sin")
+		return opNode(callNode("cos", u->clone()), '*', du);
+	if (f == "cos")
+		return opNode(constNode(0), '-', opNode(callNode("sin", u->clone()), '*', du));
+	if (f == "tan")
+		return opNode(du, '/', opNode(callNode("cos", u->clone()), '^', constNode(2)));
+	if (f == "cot")
+		return opNode(constNode(0), '-', opNode(du, '/', opNode(callNode("sin", u->clone()), '^', constNode(2))));
+	if (f == "atan")
+		return opNode(du, '/', opNode(constNode(1), '+', opNode(u->clone(), '^', constNode(2))));
+	if (f == "torad")
+		return opNode(constNode(degtorad(1)), '*', du);
+	return opNode(constNode(radtodeg(1)), '*', du);
+}
+
+// Rejects the whole tree up front so that a failure never leaves a partly
+// built derivative behind.
+void checkDifferentiable(const exprnode *root, const std::string &varname){
+	if (!dependsOn(root, varname))
+		return;
+	if (!contains("v+-*/^f", root->opcode))
+		throw DomainError();
+	if (root->opcode == 'f' && !(root->varname == "abs" || root->varname == "sqrt" ||
+								 root->varname == "exp" || root->varname == "ln" ||
+								 root->varname == "sin" || root->varname == "cos" ||
+								 root->varname == "tan" || root->varname == "cot" ||
+								 root->varname == "atan" || root->varname == "torad" ||
+								 root->varname == "todeg"))
+		throw DomainError();
+	checkDifferentiable(root->left, varname);
+	checkDifferentiable(root->right, varname);
+}
+
+exprnode *derivative(const exprnode *root, const std::string &varname){
+	checkDifferentiable(root, varname);
+	return buildDerivative(root, varname);
+}
+
+exprnode *buildDerivative(const exprnode *root, const std::string &varname){
+	if (!dependsOn(root, varname))
+		return constNode(0);
+	const exprnode *l = root->left, *r = root->right;
+	switch (root->opcode){
+	case 'v':
+		return constNode(1);
+	case '+':
+	case '-':
+		return opNode(buildDerivative(l, varname), root->opcode, buildDerivative(r, varname));
+	case '*':
+		return opNode(opNode(buildDerivative(l, varname), '*', r->clone()), '+',
+					opNode(l->clone(), '*', buildDerivative(r, varname)));
+	case '/':
+		return opNode(opNode(opNode(buildDerivative(l, varname), '*', r->clone()), '-',
+						 opNode(l->clone(), '*', buildDerivative(r, varname))),
+					'/', opNode(r->clone(), '^', constNode(2)));
+	case '^':
+		if (!dependsOn(r, varname))
+			return opNode(opNode(r->clone(), '*', opNode(l->clone(), '^', opNode(r->clone(), '-', constNode(1)))),
+						'*', buildDerivative(l, varname));
+		if (!dependsOn(l, varname))
+			return opNode(opNode(root->clone(), '*', callNode("ln", l->clone())), '*', buildDerivative(r, varname));
+		// (u^v)' = u^v * (v' ln(u) + v u' / u)
+		return opNode(root->clone(), '*',
+					opNode(opNode(buildDerivative(r, varname), '*', callNode("ln", l->clone())), '+',
+						 opNode(opNode(r->clone(), '*', buildDerivative(l, varname)), '/', l->clone())));
+	}
+	return chain(root, varname);
+}
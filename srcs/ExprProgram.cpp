@@ -0,0 +1,220 @@
+#include "ExprProgram.hpp"
+#include <limits>
+#include <algorithm>
+#include "Utils.hpp"
+
+ExprProgram::ExprProgram(){}
+
+bool ExprProgram::isCompiled() const{
+	return !code.empty();
+}
+
+bool ExprProgram::compile(const exprnode *root, const std::string &varname){
+	return compile(root, std::vector<std::string>{varname});
+}
+
+// LOAD instructions of a program of several variables carry the variable's
+// position in varnames as their value.
+bool ExprProgram::compile(const exprnode *root, const std::vector<std::string> &varnames){
+	code.clear();
+	stack.clear();
+	if (!root || !emit(root, varnames, 1)){
+		code.clear();
+		stack.clear();
+		return false;
+	}
+	return true;
+}
+
+double (*builtin(const std::string &name))(double){
+	if (name == "abs")
+		return abs;
+	if (name == "sqrt")
+		return sqrt;
+	if (name == "exp")
+		return exp;
+	if (name == "ln")
+		return ln;
+	if (name == "sin")
+		return sin;
+	if (name == "cos")
+		return cos;
+	if (name == "tan")
+		return tan;
+	if (name == "cot")
+		return cot;
+	if (name == "atan")
+		return atan;
+	if (name == "torad")
+		return degtorad;
+	if (name == "todeg")
+		return radtodeg;
+	return NULL;
+}
+
+// depth is the stack height once this subtree has been pushed.
+bool ExprProgram::emit(const exprnode *root, const std::vector<std::string> &varnames, int depth){
+	if ((int)stack.size() < depth)
+		stack.resize(depth);
+	switch (root->opcode){
+	case 'c':
+		if (!root->value.isReal())
+			return false;
+		code.push_back({PUSH, root->value.Re(), NULL});
+		return true;
+	case 'v':{
+		auto var = std::find(varnames.begin(), varnames.end(), root->varname);
+		if (var == varnames.end())
+			return false;
+		code.push_back({LOAD, (double)(var - varnames.begin()), NULL});
+		return true;
+	}
+	case 'f':{
+		double (*fn)(double) = builtin(root->varname);
+		if (!fn || !emit(root->left, varnames, depth))
+			return false;
+		code.push_back({CALL, 0, fn});
+		return true;
+	}
+	}
+	OpCode op;
+	switch (root->opcode){
+	case '+':
+		op = ADD;
+		break;
+	case '-':
+		op = SUB;
+		break;
+	case '*':
+		op = MUL;
+		break;
+	case '/':
+		op = DIV;
+		break;
+	case '^':
+		op = POW;
+		break;
+	default:
+		return false;
+	}
+	if (!emit(root->left, varnames, depth) || !emit(root->right, varnames, depth + 1))
+		return false;
+	code.push_back({op, 0, NULL});
+	return true;
+}
+
+// Domain errors of the builtins evaluate to NaN.
+double ExprProgram::operator()(double x) const{
+	return evaluate(&x);
+}
+
+// The program at the values of its variables, in the order given to
+// compile().
+double ExprProgram::evaluate(const double *values) const{
+	if (code.empty())
+		return std::numeric_limits<double>::quiet_NaN();
+	double *top = stack.data() - 1;
+	try{
+		for (const Instr &in : code){
+			switch (in.op){
+			case PUSH:
+				*++top = in.value;
+				break;
+			case LOAD:
+				*++top = values[(int)in.value];
+				break;
+			case ADD:
+				top[-1] += top[0];
+				top--;
+				break;
+			case SUB:
+				top[-1] -= top[0];
+				top--;
+				break;
+			case MUL:
+				top[-1] *= top[0];
+				top--;
+				break;
+			case DIV:
+				top[-1] /= top[0];
+				top--;
+				break;
+			case POW:
+				top[-1] = pow(top[-1], top[0]);
+				top--;
+				break;
+			case CALL:
+				*top = in.fn(*top);
+				break;
+			}
+		}
+	}catch (const DomainError &e){
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+	return *top;
+}
+
+// f at x[0] ... x[n - 1] into y, one instruction at a time over the whole
+// batch so that the arithmetic runs as vector loops. The stack is local,
+// which lets several threads share one program.
+void ExprProgram::operator()(const double *x, double *y, int n) const{
+	if (code.empty()){
+		std::fill(y, y + n, std::numeric_limits<double>::quiet_NaN());
+		return;
+	}
+	std::vector<double> buf(stack.size() * n);
+	double *top = buf.data() - n;
+	for (const Instr &in : code){
+		double *a = top - n, *b = top;
+		switch (in.op){
+		case PUSH:
+			top += n;
+			std::fill(top, top + n, in.value);
+			break;
+		case LOAD:
+			top += n;
+			std::copy(x, x + n, top);
+			break;
+		case ADD:
+			for (int k = 0; k < n; k++)
+				a[k] += b[k];
+			top = a;
+			break;
+		case SUB:
+			for (int k = 0; k < n; k++)
+				a[k] -= b[k];
+			top = a;
+			break;
+		case MUL:
+			for (int k = 0; k < n; k++)
+				a[k] *= b[k];
+			top = a;
+			break;
+		case DIV:
+			for (int k = 0; k < n; k++)
+				a[k] /= b[k];
+			top = a;
+			break;
+		case POW:
+			for (int k = 0; k < n; k++){
+				try{
+					a[k] = pow(a[k], b[k]);
+				}catch (const DomainError &e){
+					a[k] = std::numeric_limits<double>::quiet_NaN();
+				}
+			}
+			top = a;
+			break;
+		case CALL:
+			for (int k = 0; k < n; k++){
+				try{
+					b[k] = in.fn(b[k]);
+				}catch (const DomainError &e){
+					b[k] = std::numeric_limits<double>::quiet_NaN();
+				}
+			}
+			break;
+		}
+	}
+	std::copy(top, top + n, y);
+}
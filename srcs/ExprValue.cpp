@@ -1,62 +1,72 @@
 #include "ExprValue.hpp"
 #include <sstream>
 #include "Utils.hpp"
+#include "Linalg.hpp"
+#include "SmallMatrix.hpp"
+#include "Bareiss.hpp"
+#include "Parallel.hpp"
+#include <atomic>
 
-ExprValue ExprValue::operator+ (const ExprValue &rhs){
+#define GENERATE_GRAIN_ROWS 64
+#define MAP_CHUNK 4096
+#define RANGE_PRINT_ELEMENTS 16
+#define EXACT_MAX_SIZE 64
+#define EXACT_MAX_BITS 256
+
+ExprValue ExprValue::operator+ (const ExprValue &rhs) const{
 	if(scalar && rhs.scalar)
 		return ExprValue(re + rhs.re, im + rhs.im);
 	if (!scalar && !rhs.scalar && rows == rhs.rows && cols == rhs.cols){
-		ExprValue m(rows, cols);
-		for (int row = 0; row < rows; row++)
-			for (int col = 0; col < cols; col++)
-				m(row, col) = (*this)(row, col) + rhs(row, col);
-		return m;
+		if (tiled || rhs.tiled)
+			return ExprValue(Tiles()->elementwise(*rhs.Tiles(), '+'));
+		ExprValue m = combine(rhs, '+');
+		return m.withStructure(structure >= 0 && rhs.structure >= 0 ? structure & rhs.structure & DIAGONAL : -1);
 	}
 	throw InvalidOperand();
 }
 
-ExprValue ExprValue::operator- (const ExprValue &rhs){
+ExprValue ExprValue::operator- (const ExprValue &rhs) const{
 	if(scalar && rhs.scalar)
 		return ExprValue(re - rhs.re, im - rhs.im);
 	if (!scalar && !rhs.scalar && rows == rhs.rows && cols == rhs.cols)
 	{
-		ExprValue m(rows, cols);
-		for (int row = 0; row < rows; row++)
-			for (int col = 0; col < cols; col++)
-				m(row, col) = (*this)(row, col) - rhs(row, col);
-		return m;
+		if (tiled || rhs.tiled)
+			return ExprValue(Tiles()->elementwise(*rhs.Tiles(), '-'));
+		ExprValue m = combine(rhs, '-');
+		return m.withStructure(structure >= 0 && rhs.structure >= 0 ? structure & rhs.structure & DIAGONAL : -1);
 	}
 	throw InvalidOperand();
 }
 
-ExprValue ExprValue::operator* (const ExprValue &rhs){
+ExprValue ExprValue::operator* (const ExprValue &rhs) const{
 	if(scalar && rhs.scalar)
 		return ExprValue(re * rhs.re - im * rhs.im, im * rhs.re + re * rhs.im);
 	if (!scalar && !rhs.scalar && rows == rhs.rows && cols == rhs.cols){
-		ExprValue m(rows, cols);
-		for (int row = 0; row < rows; row++)
-			for (int col = 0; col < cols; col++)
-				m(row, col) = (*this)(row, col) * rhs(row, col);
-		return m;
+		if (tiled || rhs.tiled)
+			return ExprValue(Tiles()->elementwise(*rhs.Tiles(), '*'));
+		ExprValue m = combine(rhs, '*');
+		if (structure < 0 || rhs.structure < 0)
+			return m;
+		// a zero in either operand stays zero
+		int s = ((structure | rhs.structure) & (UPPER | LOWER)) | (structure & rhs.structure & SYMMETRIC);
+		return m.withStructure((s & (UPPER | LOWER)) == (UPPER | LOWER) ? DIAGONAL : s);
 	}
 	if(scalar && im==0 && !rhs.scalar){
-		ExprValue m(rhs.rows, rhs.cols);
-		for (int row = 0; row < rhs.rows; row++)
-			for (int col = 0; col < rhs.cols; col++)
-				m(row, col) = re * rhs(row, col);
-		return m;
+		if (rhs.tiled)
+			return ExprValue(rhs.tiled->scalarOp(re, '*'));
+		ExprValue m = rhs.scaled(re, '*');
+		return m.withStructure(rhs.structure >= 0 ? rhs.structure & DIAGONAL : -1);
 	}
 	if(!scalar && rhs.scalar && rhs.im==0){
-		ExprValue m(rows, cols);
-		for (int row = 0; row < rows; row++)
-			for (int col = 0; col < cols; col++)
-				m(row, col) = (*this)(row, col) * rhs.re;
-		return m;
+		if (tiled)
+			return ExprValue(tiled->scalarOp(rhs.re, '*'));
+		ExprValue m = scaled(rhs.re, '*');
+		return m.withStructure(structure >= 0 ? structure & DIAGONAL : -1);
 	}
 	throw InvalidOperand();
 }
 
-ExprValue ExprValue::operator/ (const ExprValue &rhs){
+ExprValue ExprValue::operator/ (const ExprValue &rhs) const{
 	if(scalar && rhs.scalar){
 		double c2d2 = rhs.re * rhs.re + rhs.im * rhs.im;
 		if (c2d2 == 0)
@@ -65,16 +75,15 @@ ExprValue ExprValue::operator/ (const ExprValue &rhs){
 						 (im * rhs.re - re * rhs.im) / c2d2);
 	}
 	if(!scalar && rhs.scalar && rhs.im==0){
-		ExprValue m(rows, cols);
-		for (int row = 0; row < rows; row++)
-			for (int col = 0; col < cols; col++)
-				m(row, col) = (*this)(row, col) / rhs.re;
-		return m;
+		if (tiled)
+			return ExprValue(tiled->scalarOp(rhs.re, '/'));
+		ExprValue m = scaled(rhs.re, '/');
+		return m.withStructure(structure >= 0 ? structure & DIAGONAL : -1);
 	}
 	throw InvalidOperand();
 }
 
-ExprValue ExprValue::operator% (const ExprValue &rhs){
+ExprValue ExprValue::operator% (const ExprValue &rhs) const{
 	if (scalar && im == 0 && re == (int)re 
 		&& rhs.scalar && rhs.im == 0 && rhs.re == (int)rhs.re){
 		return ExprValue((double)((int)re % (int)rhs.re), 0.);
@@ -82,7 +91,7 @@ ExprValue ExprValue::operator% (const ExprValue &rhs){
 	throw InvalidOperand();
 }
 
-ExprValue ExprValue::operator^ (const ExprValue &rhs){
+ExprValue ExprValue::operator^ (const ExprValue &rhs) const{
 	// if (scalar && im == 0 && rhs.scalar && rhs.im == 0)
 	// 	return ExprValue(pow(re, rhs.re), 0.);
 	if (scalar && rhs.scalar && rhs.im == 0 && rhs.re==(int)rhs.re){
@@ -101,71 +110,174 @@ ExprValue ExprValue::operator^ (const ExprValue &rhs){
 		return ExprValue(rn * cos(nphi), rn * sin(nphi));
 	}
 	if (!scalar && rows == cols && rhs.scalar && rhs.im == 0 && rhs.re == (int)rhs.re && rhs.re >= 0){
+		int s = getStructure();
+		if (s == IDENTITY)
+			return *this;
 		ExprValue r(rows, cols);
-		for (int i = 0; i < rows;i++)
-			r(i, i) = 1.;
+		if (s == DIAGONAL){
+			for (int i = 0; i < rows; i++)
+				r.Data()[i * cols + i] = (ExprValue(at(i, i), 0.) ^ rhs).re;
+			return r.withStructure(DIAGONAL);
+		}
+		// products of triangular matrices are exactly triangular
+		int triangular = s == UPPER || s == LOWER ? s : -1;
+		if (dispatchSmall(rows, [&](auto n){ smallPow<decltype(n)::value>(Data(), (long long)rhs.re, r.Data()); }))
+			return r.withStructure(triangular);
+		if (rhs.re == 0){
+			for (int i = 0; i < rows; i++)
+				r.Data()[i * cols + i] = 1.;
+			return r.withStructure(IDENTITY);
+		}
+		bool first = true;
 		ExprValue x = *this;
 		for (long long p = rhs.re; p > 0; p >>= 1){
-			if (p & 1)
-				r = r & x;
-			x = x & x;
+			if (p & 1){
+				r = first ? x : r & x;
+				first = false;
+			}
+			if (p > 1)
+				x = x & x;
 		}
-		return r;
+		return r.withStructure(triangular);
 	}
 	if (!scalar && rows == cols && rhs.scalar && rhs.im == 0 && rhs.re == (int)rhs.re)
 		return Inv() ^ ExprValue(-rhs.re, 0.);
 	throw InvalidOperand();
 }
 
-bool ExprValue::operator==(const ExprValue &rhs){
-	return (scalar && rhs.scalar && re == rhs.re && im == rhs.im) 
-		|| (!scalar && !rhs.scalar && a == rhs.a);
+bool ExprValue::operator==(const ExprValue &rhs) const{
+	if (scalar || rhs.scalar)
+		return scalar && rhs.scalar && re == rhs.re && im == rhs.im;
+	if (rows != rhs.rows || cols != rhs.cols)
+		return false;
+	densify();
+	rhs.densify();
+	for (int row = 0; row < rows; row++)
+		for (int col = 0; col < cols; col++)
+			if (at(row, col) != rhs.at(row, col))
+				return false;
+	return true;
 }
 
-bool ExprValue::operator!=(const ExprValue &rhs){
+bool ExprValue::operator!=(const ExprValue &rhs) const{
 	return !(*this == rhs);
 }
 
-ExprValue ExprValue::operator&(const ExprValue &rhs){
+ExprValue ExprValue::operator&(const ExprValue &rhs) const{
 	if(!scalar && !rhs.scalar && cols==rhs.rows){
+		if (tiled || rhs.tiled)
+			return ExprValue(Tiles()->multiply(*rhs.Tiles()));
+		int s = -1;
+		if (rows == cols && cols == rhs.cols && structure >= 0 && rhs.structure >= 0){
+			if (structure == IDENTITY)
+				return rhs;
+			if (rhs.structure == IDENTITY)
+				return *this;
+			s = structure & rhs.structure & (UPPER | LOWER);
+			s = s == (UPPER | LOWER) ? DIAGONAL : s;
+		}
+		if (f32 && rhs.f32){
+			ExprValue m(rows, rhs.cols, std::make_shared<std::vector<float>>((size_t)rows * rhs.cols));
+			matmul(f32->data(), rhs.f32->data(), m.f32->data(), rows, cols, rhs.cols, false);
+			return m.withStructure(s);
+		}
 		ExprValue m(rows, rhs.cols);
-		for (int row = 0; row < rows; row++)
-			for (int col = 0; col < rhs.cols; col++){
-				m(row, col) = 0;
-				for (int k = 0; k < cols;k++)
-					m(row, col) += (*this)(row, k) * rhs(k, col);
-			}
-		return m;
+		if (rows == cols && cols == rhs.cols
+			&& dispatchSmall(rows, [&](auto n){ smallMul<decltype(n)::value>(Data(), rhs.Data(), m.Data()); }))
+			return m.withStructure(s);
+		// A A and A A^T are symmetric whenever A is, resp. always
+		bool symmetric = rows == rhs.cols
+			&& ((&rhs == this && hasStructure(SYMMETRIC)) || isTransposeOf(rhs));
+		matmul(Data(), rhs.Data(), m.Data(), rows, cols, rhs.cols, symmetric);
+		return m.withStructure(symmetric ? (s >= 0 ? s | SYMMETRIC : SYMMETRIC) : s);
 	}
 	throw InvalidOperand();
 }
 
+// Writing past the last row or column grows the matrix, which is how
+// literals are read.
 double &ExprValue::operator()(int row, int col){
 	if (!scalar && 0 <= row && 0 <= col){
+		unshare();
 		if (col >= cols)
-			cols = col + 1;
+			cols = ld = col + 1;
 		if (row >= rows)
 			rows = row + 1;
-		a.resize(rows * cols, 0.);
-		return a[row * cols + col];
+		if (buf->size() != (size_t)rows * cols)
+			buf->resize((size_t)rows * cols);
+		structure = -1;
+		return buf->data()[(size_t)row * cols + col];
 	}
 	throw InvalidOperand();
 }
 
 const double &ExprValue::operator()(int row, int col) const{
-	if (!scalar && 0 <= row && row < rows && 0 <= col && col < cols)
-		return a[row * cols + col];
+	if (!scalar && 0 <= row && row < rows && 0 <= col && col < cols){
+		densify();
+		return buf->data()[offset + (size_t)row * ld + col];
+	}
 	throw InvalidOperand();
 }
 
+// One element, read from its tile if the matrix is on disk.
+double ExprValue::Get(int row, int col) const{
+	if (tiled && 0 <= row && row < rows && 0 <= col && col < cols)
+		return tiled->get(row, col);
+	if (range && !buf && row == 0 && 0 <= col && col < cols)
+		return rangeStart + col * rangeStep;
+	return (*this)(row, col);
+}
+
+double ExprValue::at(int row, int col) const{
+	return buf->data()[offset + (size_t)row * ld + col];
+}
+
+bool ExprValue::isContiguous() const{
+	return ld == cols || rows == 1;
+}
+
+// Gives this value a buffer of its own, packed row by row, unless it
+// already is the only holder of one.
+void ExprValue::unshare(){
+	densify();
+	f32.reset();
+	range = false;
+	if (buf.use_count() == 1 && offset == 0 && ld == cols && buf->size() == (size_t)rows * cols)
+		return;
+	std::shared_ptr<MatBuffer> own = std::make_shared<MatBuffer>((size_t)rows * cols);
+	for (int row = 0; row < rows; row++)
+		std::copy(buf->data() + offset + (size_t)row * ld, buf->data() + offset + (size_t)row * ld + cols,
+				  own->data() + (size_t)row * cols);
+	buf = own;
+	offset = 0;
+	ld = cols;
+}
+
 ExprValue::ExprValue() : scalar(true), re(0), im(0) {}
 
 ExprValue::ExprValue(double re, double im) : scalar(true), re(re), im(im) {}
 
-ExprValue::ExprValue(int rows, int cols) : scalar(false), rows(rows), cols(cols){
+ExprValue::ExprValue(int rows, int cols) : scalar(false), rows(rows), cols(cols), ld(cols){
 	if (rows < 1 || cols < 1)
 		throw InvalidOperand();
-	a.resize(rows * cols, 0.);
+	buf = std::make_shared<MatBuffer>((size_t)rows * cols);
+}
+
+// Wraps rows * cols packed elements already in buf, without copying them.
+ExprValue::ExprValue(int rows, int cols, const std::shared_ptr<MatBuffer> &buf)
+	: scalar(false), rows(rows), cols(cols), buf(buf), ld(cols){
+	if (rows < 1 || cols < 1 || buf->size() < (size_t)rows * cols)
+		throw InvalidOperand();
+}
+
+ExprValue::ExprValue(const std::shared_ptr<TiledMatrix> &tiled)
+	: scalar(false), rows(tiled->rows()), cols(tiled->cols()), ld(tiled->cols()), tiled(tiled) {}
+
+// A float matrix of rows * cols packed elements.
+ExprValue::ExprValue(int rows, int cols, const std::shared_ptr<std::vector<float>> &f32)
+	: scalar(false), rows(rows), cols(cols), ld(cols), f32(f32){
+	if (rows < 1 || cols < 1 || f32->size() < (size_t)rows * cols)
+		throw InvalidOperand();
 }
 
 ExprValue::ExprValue(const ExprValue &other){
@@ -176,12 +288,20 @@ ExprValue::ExprValue(const ExprValue &other){
 ExprValue &ExprValue::operator=(const ExprValue &other){
 	if (this == &other)
 		return (*this);
-	this->a = other.a;
+	this->buf = other.buf;
+	this->offset = other.offset;
+	this->ld = other.ld;
+	this->tiled = other.tiled;
+	this->f32 = other.f32;
+	this->range = other.range;
+	this->rangeStart = other.rangeStart;
+	this->rangeStep = other.rangeStep;
 	this->im = other.im;
 	this->rows = other.rows;
 	this->cols = other.cols;
 	this->re = other.re;
 	this->scalar = other.scalar;
+	this->structure = other.structure;
 	return (*this);
 }
 
@@ -193,6 +313,62 @@ double ExprValue::Im() const{
 	return im;
 }
 
+int ExprValue::Rows() const{
+	return scalar ? 1 : rows;
+}
+
+int ExprValue::Cols() const{
+	return scalar ? 1 : cols;
+}
+
+// Row-major elements, packed; the writable pointer is to a buffer of this
+// value's own.
+double *ExprValue::Data(){
+	if (scalar)
+		return NULL;
+	unshare();
+	structure = -1;
+	return buf->data();
+}
+
+// Slices that are not packed (columns, blocks narrower than the matrix) are
+// packed into a buffer of their own on the first call.
+const double *ExprValue::Data() const{
+	if (scalar)
+		return NULL;
+	densify();
+	if (!isContiguous()){
+		std::shared_ptr<MatBuffer> own = std::make_shared<MatBuffer>((size_t)rows * cols);
+		for (int row = 0; row < rows; row++)
+			for (int col = 0; col < cols; col++)
+				own->data()[(size_t)row * cols + col] = at(row, col);
+		buf = own;
+		offset = 0;
+		ld = cols;
+	}
+	return buf->data() + offset;
+}
+
+// Packed elements of an f32 matrix, NULL for any other value.
+const float *ExprValue::DataF32() const{
+	return f32 ? f32->data() : NULL;
+}
+
+// The buffer holding this matrix's elements, shared by its copies and slices.
+const void *ExprValue::Buffer() const{
+	if (scalar)
+		return NULL;
+	return f32 ? (const void *)f32.get() : (const void *)buf.get();
+}
+
+size_t ExprValue::BufferBytes() const{
+	if (scalar)
+		return 0;
+	if (f32)
+		return f32->size() * sizeof(float);
+	return buf ? buf->size() * sizeof(double) : 0;
+}
+
 bool ExprValue::isReal() const{
 	return scalar && im == 0;
 }
@@ -205,75 +381,345 @@ bool ExprValue::isMatrix() const{
 	return !scalar;
 }
 
+bool ExprValue::isTiled() const{
+	return tiled != NULL;
+}
+
+bool ExprValue::isF32() const{
+	return f32 != NULL;
+}
+
+bool ExprValue::isRange() const{
+	return range;
+}
+
+double ExprValue::RangeStart() const{
+	return rangeStart;
+}
+
+double ExprValue::RangeStep() const{
+	return rangeStep;
+}
+
+// Makes the elements readable as doubles through buf: widens a float
+// matrix, or brings a tiled one or a range into memory if it fits in the
+// memory limit.
+void ExprValue::densify() const{
+	if (f32 && !buf){
+		buf = std::make_shared<MatBuffer>((size_t)rows * cols);
+		std::copy(f32->begin(), f32->begin() + (size_t)rows * cols, buf->data());
+		offset = 0;
+		ld = cols;
+	}
+	if (range && !buf){
+		if (!fitsInMemory(rows, cols))
+			throw TiledMatrix::TooLarge();
+		buf = std::make_shared<MatBuffer>((size_t)cols);
+		for (int k = 0; k < cols; k++)
+			buf->data()[k] = rangeStart + k * rangeStep;
+		offset = 0;
+		ld = cols;
+	}
+	if (!tiled)
+		return;
+	if ((size_t)rows * cols * sizeof(double) > TiledMatrix::memoryLimit())
+		throw TiledMatrix::TooLarge();
+	buf = std::make_shared<MatBuffer>((size_t)rows * cols);
+	tiled->toDense(buf->data());
+	offset = 0;
+	ld = cols;
+	tiled.reset();
+}
+
+std::shared_ptr<TiledMatrix> ExprValue::Tiles() const{
+	if (range && !buf && !fitsInMemory(rows, cols)){
+		double start = rangeStart, step = rangeStep;
+		return TiledMatrix::generate(rows, cols, [=](int, int col, int, int ncols, double *a, int){
+			for (int j = 0; j < ncols; j++)
+				a[j] = start + (col + j) * step;
+		});
+	}
+	return tiled ? tiled : TiledMatrix::fromDense(Data(), rows, cols);
+}
+
+ExprValue ExprValue::Tiled() const{
+	if (scalar)
+		throw InvalidOperand();
+	return ExprValue(Tiles());
+}
+
+ExprValue ExprValue::Dense() const{
+	if (scalar)
+		throw InvalidOperand();
+	ExprValue r = *this;
+	r.densify();
+	return r;
+}
+
+// Rounds the elements to float; the structure bits survive the rounding.
+ExprValue ExprValue::F32() const{
+	if (scalar)
+		throw InvalidOperand();
+	if (f32)
+		return *this;
+	const double *a = Data();
+	ExprValue r(rows, cols, std::make_shared<std::vector<float>>(a, a + (size_t)rows * cols));
+	r.structure = structure;
+	return r;
+}
+
+ExprValue ExprValue::F64() const{
+	if (scalar)
+		throw InvalidOperand();
+	if (!f32)
+		return *this;
+	ExprValue r(rows, cols);
+	std::copy(f32->begin(), f32->begin() + (size_t)rows * cols, r.Data());
+	return r.withStructure(structure);
+}
+
+// Elementwise this op rhs through the float kernel when both are f32, else
+// through the double one, an f32 operand being widened first.
+ExprValue ExprValue::combine(const ExprValue &rhs, char opcode) const{
+	if (f32 && rhs.f32){
+		ExprValue m(rows, cols, std::make_shared<std::vector<float>>((size_t)rows * cols));
+		elementwise(f32->data(), cols, rhs.f32->data(), cols, m.f32->data(), rows, cols, opcode);
+		return m;
+	}
+	densify();
+	rhs.densify();
+	ExprValue m(rows, cols);
+	elementwise(buf->data() + offset, ld, rhs.buf->data() + rhs.offset, rhs.ld, m.Data(), rows, cols, opcode);
+	return m;
+}
+
+// Every element times or divided by a real s, keeping the dtype.
+ExprValue ExprValue::scaled(double s, char opcode) const{
+	if (f32){
+		ExprValue m(rows, cols, std::make_shared<std::vector<float>>((size_t)rows * cols));
+		scale(f32->data(), cols, (float)s, m.f32->data(), rows, cols, opcode);
+		return m;
+	}
+	densify();
+	ExprValue m(rows, cols);
+	scale(buf->data() + offset, ld, s, m.Data(), rows, cols, opcode);
+	return m;
+}
+
+// Structure bits of a square matrix (GENERAL for anything else). Operations
+// set them on their results when they follow from the operands; otherwise
+// they are found by one scan on first use and cached until the next write.
+int ExprValue::getStructure() const{
+	if (structure < 0)
+		structure = tiled ? GENERAL : scanStructure();
+	return structure;
+}
+
+bool ExprValue::hasStructure(int s) const{
+	return (getStructure() & s) == s;
+}
+
+ExprValue &ExprValue::withStructure(int s){
+	structure = scalar || rows != cols ? GENERAL : s;
+	return *this;
+}
+
+int ExprValue::scanStructure() const{
+	if (scalar || rows != cols)
+		return GENERAL;
+	densify();
+	int s = DIAGONAL;
+	bool ones = true;
+	for (int i = 0; i < rows; i++){
+		ones = ones && at(i, i) == 1;
+		for (int j = 0; j < i; j++){
+			double lo = at(i, j), up = at(j, i);
+			if (lo != 0)
+				s &= ~UPPER;
+			if (up != 0)
+				s &= ~LOWER;
+			if (lo != up)
+				s &= ~SYMMETRIC;
+		}
+	}
+	return s == DIAGONAL && ones ? IDENTITY : s;
+}
+
+double ExprValue::diagProduct() const{
+	double d = 1;
+	for (int i = 0; i < rows; i++)
+		d *= at(i, i);
+	return d;
+}
+
+// Square matrices of integers only, which have exact det, adj and inverse,
+// as long as that stays cheap: beyond EXACT_MAX_SIZE or a determinant of up
+// to EXACT_MAX_BITS bits, the elimination in BigInt costs hundreds of times
+// the floating-point one.
+bool ExprValue::isIntegral() const{
+	return !scalar && !tiled && rows == cols && rows <= EXACT_MAX_SIZE
+		&& ::isIntegral(Data(), (size_t)rows * cols) && hadamardBits(Data(), rows) <= EXACT_MAX_BITS;
+}
+
+bool ExprValue::isTransposeOf(const ExprValue &other) const{
+	if (scalar || other.scalar || tiled || other.tiled || rows != other.cols || cols != other.rows)
+		return false;
+	densify();
+	other.densify();
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < cols; j++)
+			if (at(i, j) != other.at(j, i))
+				return false;
+	return true;
+}
+
 ExprValue ExprValue::Abs() const{
 	if (!scalar)
 		return Det();
 	return ExprValue(sqrt(re * re + im * im), 0.);
 }
 
+// fn of every element, in chunks split across threads; ranges compute their
+// elements as they go, and matrices over the memory limit are mapped a
+// tile at a time into a tiled result.
+ExprValue ExprValue::map(double (*fn)(double)) const{
+	if (!fitsInMemory(rows, cols) && (tiled || (range && !buf))){
+		std::shared_ptr<TiledMatrix> t = tiled;
+		double start = rangeStart, step = rangeStep;
+		return generate(rows, cols, [=](int row, int col, int nrows, int ncols, double *a, int ld){
+			if (t){
+				std::vector<double> b((size_t)nrows * ncols);
+				t->block(row, col, nrows, ncols, b.data());
+				for (int i = 0; i < nrows; i++)
+					for (int j = 0; j < ncols; j++)
+						a[(size_t)i * ld + j] = fn(b[(size_t)i * ncols + j]);
+			}else
+				for (int j = 0; j < ncols; j++)
+					a[j] = fn(start + (col + j) * step);
+		});
+	}
+	const double *a = range && !buf ? NULL : Data();
+	ExprValue m(rows, cols);
+	double *out = m.Data();
+	size_t total = (size_t)rows * cols, chunks = (total + MAP_CHUNK - 1) / MAP_CHUNK;
+	std::atomic<bool> failed(false);
+	parallelFor(0, chunks, 1, [&](int from, int to){
+		try{
+			for (size_t k = (size_t)from * MAP_CHUNK; k < total && k < (size_t)to * MAP_CHUNK; k++)
+				out[k] = fn(a ? a[k] : rangeStart + k * rangeStep);
+		}catch (const DomainError &){
+			failed = true;
+		}
+	});
+	if (failed)
+		throw DomainError();
+	return f32 ? m.F32() : m;
+}
+
 ExprValue ExprValue::Sqrt() const{
-	if(!scalar || im!=0)
+	if (!scalar)
+		return map(sqrt);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(sqrt(re), 0.);
 }
 
 ExprValue ExprValue::Exp() const{
-	if (!scalar || im != 0)
+	if (!scalar)
+		return map(exp);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(exp(re), 0.);
 }
 
 ExprValue ExprValue::Ln() const{
-	if (!scalar || im != 0)
+	if (!scalar)
+		return map(ln);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(ln(re), 0.);
 }
 
 ExprValue ExprValue::Sin() const{
-	if (!scalar || im != 0)
+	if (!scalar)
+		return map(sin);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(sin(re), 0.);
 }
 
 ExprValue ExprValue::Cos() const{
-	if (!scalar || im != 0)
+	if (!scalar)
+		return map(cos);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(cos(re), 0.);
 }
 
 ExprValue ExprValue::Tan() const{
-	if (!scalar || im != 0)
+	if (!scalar)
+		return map(tan);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(tan(re), 0.);
 }
 
 ExprValue ExprValue::Cot() const{
-	if (!scalar || im != 0)
+	if (!scalar)
+		return map(cot);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(cot(re), 0.);
 }
 
 ExprValue ExprValue::Atan() const{
-	if (!scalar || im != 0)
+	if (!scalar)
+		return map(atan);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(atan(re), 0.);
 }
 
 ExprValue ExprValue::DegToRad() const{
-	if (!scalar || im != 0)
+	if (!scalar)
+		return map(degtorad);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(degtorad(re), 0.);
 }
 
 ExprValue ExprValue::RadToDeg() const{
-	if (!scalar || im != 0)
+	if (!scalar)
+		return map(radtodeg);
+	if (im != 0)
 		throw DomainError();
 	return ExprValue(radtodeg(re), 0.);
 }
 
-ExprValue ExprValue::Det() const{
+// Matrices of integers get their determinant exactly; exact, when given, is
+// set to its digits if the double returned is not.
+ExprValue ExprValue::Det(std::string *exact) const{
 	if(scalar || rows!=cols)
 		throw InvalidOperand();
+	if (tiled)
+		return ExprValue(tiled->det(), 0.);
+	bool triangular = hasStructure(UPPER) || hasStructure(LOWER);
+	if (isIntegral()){
+		BigInt d = 1;
+		if (triangular)
+			for (int i = 0; i < rows; i++)
+				d = d * BigInt((long long)at(i, i));
+		else
+			d = exactDet(Data(), rows);
+		if (exact && !isExactDouble(d, 1))
+			*exact = d.toString();
+		return ExprValue(d.toDouble(), 0.);
+	}
+	if (triangular)
+		return ExprValue(diagProduct(), 0.);
+	double d;
+	if (dispatchSmall(rows, [&](auto n){ d = smallDet<decltype(n)::value>(Data()); }))
+		return ExprValue(d, 0.);
 	return Det(0, 0, rows, -1, -1);
 }
 
@@ -298,6 +744,8 @@ ExprValue ExprValue::Det(int fromrow, int fromcol, int size, int exceptrow, int
 ExprValue ExprValue::Cof()const{
 	if (scalar || rows != cols)
 		throw InvalidOperand();
+	if (isIntegral())
+		return Adj().Trans();
 	ExprValue r(rows, cols);
 	for (int row = 0; row < rows; row++)
 		for (int col = 0; col < cols;col++)
@@ -308,24 +756,524 @@ ExprValue ExprValue::Cof()const{
 ExprValue ExprValue::Trans() const{
 	if (scalar)
 		throw InvalidOperand();
+	if (tiled)
+		return ExprValue(tiled->transpose());
+	int s = structure < 0 ? -1 : (structure & ~(UPPER | LOWER))
+		| (structure & UPPER ? LOWER : 0) | (structure & LOWER ? UPPER : 0);
+	if (f32){
+		ExprValue r(cols, rows, std::make_shared<std::vector<float>>((size_t)rows * cols));
+		transpose(f32->data(), cols, r.f32->data(), rows, cols);
+		return r.withStructure(s);
+	}
 	ExprValue r(cols, rows);
-	for (int row = 0; row < rows; row++)
-		for (int col = 0; col < cols; col++)
-			r(col, row) = (*this)(row, col);
-	return r;
+	if (rows == cols && dispatchSmall(rows, [&](auto n){ smallTrans<decltype(n)::value>(Data(), r.Data()); }))
+		return r.withStructure(s);
+	densify();
+	transpose(buf->data() + offset, ld, r.Data(), rows, cols);
+	return r.withStructure(s);
 }
 
-ExprValue ExprValue::Adj() const{
+ExprValue ExprValue::Adj(std::string *exact) const{
+	if (!scalar && rows == cols && isIntegral()){
+		std::vector<BigInt> adj;
+		exactAdj(Data(), rows, adj);
+		ExprValue r(rows, cols);
+		double *out = r.Data();
+		bool exactDouble = true;
+		for (size_t k = 0; k < adj.size(); k++){
+			out[k] = adj[k].toDouble();
+			exactDouble = exactDouble && isExactDouble(adj[k], 1);
+		}
+		if (exact && !exactDouble)
+			*exact = exactString(adj, 1, rows, cols);
+		return r;
+	}
+	if (!scalar && rows == cols){
+		ExprValue r(rows, cols);
+		if (dispatchSmall(rows, [&](auto n){ smallAdj<decltype(n)::value>(Data(), r.Data()); }))
+			return r;
+	}
 	return Cof().Trans();
 }
 
-ExprValue ExprValue::Inv() const{
+// Matrices of integers are inverted exactly, as adj(A) / det(A); exact, when
+// given, is set to the reduced fractions if some element is not a double.
+ExprValue ExprValue::Inv(std::string *exact) const{
+	int s = getStructure();
+	if (s != IDENTITY && s != DIAGONAL && !((s == UPPER || s == LOWER) && rows > 4) && isIntegral()){
+		std::vector<BigInt> adj;
+		BigInt det = exactAdj(Data(), rows, adj);
+		if (det.isZero())
+			throw InvalidOperand();
+		ExprValue r(rows, cols);
+		double *out = r.Data();
+		bool exactDouble = true;
+		for (size_t k = 0; k < adj.size(); k++){
+			out[k] = BigInt::ratio(adj[k], det);
+			exactDouble = exactDouble && (!exact || isExactDouble(adj[k], det));
+		}
+		if (exact && !exactDouble)
+			*exact = exactString(adj, det, rows, cols);
+		return r;
+	}
 	ExprValue det = Det();
 	if (abs(det.Re()) < 1e-9)
 		throw InvalidOperand();
+	ExprValue r(rows, cols);
+	if (s == IDENTITY)
+		return *this;
+	if (s == DIAGONAL){
+		for (int i = 0; i < rows; i++)
+			r.Data()[i * cols + i] = 1 / at(i, i);
+		return r.withStructure(DIAGONAL);
+	}
+	if ((s == UPPER || s == LOWER) && rows > 4){
+		double *out = r.Data();
+		for (int i = 0; i < rows; i++)
+			out[i * cols + i] = 1.;
+		triangularSolve(Data(), rows, s == UPPER, false, out, cols);
+		return r.withStructure(s);
+	}
+	double inv = 1 / det.Re();
+	if (dispatchSmall(rows, [&](auto n){
+		double *out = r.Data();
+		smallAdj<decltype(n)::value>(Data(), out);
+		for (int k = 0; k < rows * cols; k++)
+			out[k] *= inv;
+	}))
+		return r;
 	return Adj() / det;
 }
 
+// Solves this * X = rhs for every column of rhs with one factorization:
+// Cholesky when the matrix is symmetric positive definite, LU with partial
+// pivoting otherwise. rcond receives the reciprocal 1-norm condition number.
+ExprValue ExprValue::Solve(const ExprValue &rhs, double &rcond) const{
+	if (scalar || rhs.scalar || rows != cols || rhs.rows != rows)
+		throw InvalidOperand();
+	int n = rows;
+	if (tiled){
+		ExprValue x = rhs.Dense();
+		if (!tiled->solve(x.Data(), x.cols, rcond))
+			throw SingularMatrix();
+		return x.withStructure(-1);
+	}
+	int s = getStructure();
+	if (s == DIAGONAL || s == IDENTITY)
+		return SolveDiagonal(rhs, rcond);
+	if (s == UPPER || s == LOWER){
+		ExprValue x = rhs;
+		const double *t = Data();
+		if (!triangularSolve(t, n, s == UPPER, false, x.Data(), x.cols))
+			throw SingularMatrix();
+		rcond = 1 / (norm1(t, n) * invNorm1(n, [&](double *b, bool trans){
+			triangularSolve(t, n, s == UPPER, trans, b, 1);
+		}));
+		return x.withStructure(-1);
+	}
+	std::vector<double> f(Data(), Data() + n * n);
+	std::vector<int> perm(n);
+	bool spd = hasStructure(SYMMETRIC) && cholesky(f.data(), n);
+	if (!spd){
+		f.assign(Data(), Data() + n * n);
+		if (!lu(f.data(), n, perm.data()))
+			throw SingularMatrix();
+	}
+	ExprValue x = rhs;
+	std::function<void(double *, bool)> solve;
+	if (spd)
+		solve = [&](double *b, bool){ choleskySolve(f.data(), n, b, 1); };
+	else
+		solve = [&](double *b, bool trans){
+			if (trans)
+				luSolveTrans(f.data(), n, perm.data(), b);
+			else
+				luSolve(f.data(), n, perm.data(), b, 1);
+		};
+	if (spd)
+		choleskySolve(f.data(), n, x.Data(), x.cols);
+	else
+		luSolve(f.data(), n, perm.data(), x.Data(), x.cols);
+	rcond = 1 / (norm1(Data(), n) * invNorm1(n, solve));
+	return x.withStructure(-1);
+}
+
+// Diagonal systems scale each row; the condition number is exact.
+ExprValue ExprValue::SolveDiagonal(const ExprValue &rhs, double &rcond) const{
+	ExprValue x = rhs;
+	double *out = x.Data();
+	double lo = -1, hi = 0;
+	for (int i = 0; i < rows; i++){
+		double d = at(i, i);
+		if (d == 0)
+			throw SingularMatrix();
+		for (int c = 0; c < x.cols; c++)
+			out[i * x.cols + c] /= d;
+		lo = lo < 0 || abs(d) < lo ? abs(d) : lo;
+		hi = abs(d) > hi ? abs(d) : hi;
+	}
+	rcond = lo / hi;
+	return x.withStructure(-1);
+}
+
+// Eigenvalues as a column, or as re/im columns when some are complex.
+ExprValue ExprValue::Eig() const{
+	if (scalar || rows != cols)
+		throw InvalidOperand();
+	int n = rows;
+	std::vector<double> wr(n), wi(n, 0.);
+	if (hasStructure(SYMMETRIC) ? !eigenSymmetric(Data(), n, wr.data(), NULL)
+					  : !eigenGeneral(Data(), n, wr.data(), wi.data(), NULL))
+		throw DomainError();
+	bool real = std::find_if(wi.begin(), wi.end(), [](double x){ return x != 0; }) == wi.end();
+	ExprValue r(n, real ? 1 : 2);
+	for (int i = 0; i < n; i++){
+		r(i, 0) = wr[i];
+		if (!real)
+			r(i, 1) = wi[i];
+	}
+	return r;
+}
+
+// Unit eigenvectors as columns in the order of Eig(); the vector of a complex
+// pair takes two columns, real part first.
+ExprValue ExprValue::EigVec() const{
+	if (scalar || rows != cols)
+		throw InvalidOperand();
+	int n = rows;
+	std::vector<double> wr(n), wi(n);
+	ExprValue r(n, n);
+	if (hasStructure(SYMMETRIC) ? !eigenSymmetric(Data(), n, wr.data(), r.Data())
+					  : !eigenGeneral(Data(), n, wr.data(), wi.data(), r.Data()))
+		throw DomainError();
+	return r;
+}
+
+// Block of nrows x ncols elements from (row, col), sharing this matrix's
+// buffer: no element is copied until one side is written.
+ExprValue ExprValue::Slice(int row, int nrows, int col, int ncols) const{
+	if (scalar || row < 0 || col < 0 || nrows < 1 || ncols < 1
+		|| row + nrows > rows || col + ncols > cols)
+		throw InvalidOperand();
+	if (tiled){
+		if ((size_t)nrows * ncols * sizeof(double) > TiledMatrix::memoryLimit())
+			throw TiledMatrix::TooLarge();
+		ExprValue r(nrows, ncols);
+		tiled->block(row, col, nrows, ncols, r.Data());
+		return r;
+	}
+	if (range && !buf)
+		return Range(rangeStart + col * rangeStep, rangeStep, ncols);
+	if (f32){
+		ExprValue r(nrows, ncols, std::make_shared<std::vector<float>>((size_t)nrows * ncols));
+		for (int i = 0; i < nrows; i++)
+			std::copy(f32->begin() + (size_t)(row + i) * cols + col, f32->begin() + (size_t)(row + i) * cols + col + ncols,
+					  r.f32->begin() + (size_t)i * ncols);
+		return r;
+	}
+	ExprValue r = *this;
+	r.rows = nrows;
+	r.cols = ncols;
+	r.offset = offset + (size_t)row * ld + col;
+	r.structure = -1;
+	return r;
+}
+
+// Joins matrices side by side (horizontal) or one above another; real
+// scalars take part as 1 x 1 matrices.
+ExprValue ExprValue::Concat(const std::vector<const ExprValue *> &parts, bool horizontal){
+	int rows = 0, cols = 0;
+	for (const ExprValue *p : parts){
+		if (p->scalar && p->im != 0)
+			throw InvalidOperand();
+		p->densify();
+		int r = p->Rows(), c = p->Cols();
+		if (horizontal ? rows && r != rows : cols && c != cols)
+			throw InvalidOperand();
+		rows = horizontal ? r : rows + r;
+		cols = horizontal ? cols + c : c;
+	}
+	ExprValue m(rows, cols);
+	double *out = m.Data();
+	int pos = 0;
+	for (const ExprValue *p : parts){
+		int r = p->Rows(), c = p->Cols();
+		for (int row = 0; row < r; row++)
+			for (int col = 0; col < c; col++){
+				double x = p->scalar ? p->re : p->at(row, col);
+				if (horizontal)
+					out[row * cols + pos + col] = x;
+				else
+					out[(pos + row) * cols + col] = x;
+			}
+		pos += horizontal ? c : r;
+	}
+	return m;
+}
+
+// op over the elements of a matrix, with dim one of REDUCE_ALL, REDUCE_COLS
+// or REDUCE_ROWS. Tiled matrices are reduced a tile at a time into a matrix
+// of partial results, which is then reduced the same way; ranges along
+// their row without ever being stored.
+std::vector<double> ExprValue::reduction(ReduceOp op, int dim, const double *center) const{
+	if (dim < REDUCE_ALL || dim > REDUCE_ROWS)
+		throw InvalidOperand();
+	ReduceDim d = (ReduceDim)dim;
+	std::vector<double> r(d == REDUCE_ALL ? 1 : d == REDUCE_COLS ? cols : rows);
+	if (f32){
+		reduce(f32->data(), rows, cols, cols, op, d, center, r.data());
+		return r;
+	}
+	if (range && !buf && d != REDUCE_COLS){
+		reduceSequence(rangeStart, rangeStep, cols, op, center, r.data());
+		return r;
+	}
+	if (!tiled){
+		densify();
+		reduce(buf->data() + offset, rows, cols, ld, op, d, center, r.data());
+		return r;
+	}
+	int ti = tiled->tileRows(), tj = tiled->tileCols();
+	int prows = d == REDUCE_ROWS ? rows : ti, pcols = d == REDUCE_COLS ? cols : tj;
+	std::vector<double> partial((size_t)prows * pcols), a((size_t)TILE * TILE);
+	for (int i = 0; i < ti; i++)
+		for (int j = 0; j < tj; j++){
+			int row = i * TILE, col = j * TILE;
+			int h = std::min(TILE, rows - row), w = std::min(TILE, cols - col);
+			tiled->block(row, col, h, w, a.data());
+			double *out = &partial[d == REDUCE_ROWS ? (size_t)row * pcols + j
+								   : d == REDUCE_COLS ? (size_t)i * pcols + col : (size_t)i * pcols + j];
+			const double *c = !center || d == REDUCE_ALL ? center : center + (d == REDUCE_ROWS ? row : col);
+			if (d == REDUCE_ROWS){
+				std::vector<double> band(h);
+				reduce(a.data(), h, w, w, op, d, c, band.data());
+				for (int k = 0; k < h; k++)
+					out[(size_t)k * pcols] = band[k];
+			}else
+				reduce(a.data(), h, w, w, op, d, c, out);
+		}
+	reduce(partial.data(), prows, pcols, pcols, op == REDUCE_SQDEV ? REDUCE_SUM : op, d, NULL, r.data());
+	return r;
+}
+
+// Results of a reduction as a scalar, a row (one per column) or a column
+// (one per row), rounded to float if single.
+ExprValue ExprValue::reductionValue(const std::vector<double> &r, int dim, bool single) const{
+	if (dim == REDUCE_ALL)
+		return ExprValue(r[0], 0.);
+	int n = dim == REDUCE_COLS ? 1 : rows, m = dim == REDUCE_COLS ? cols : 1;
+	if (single)
+		return ExprValue(n, m, std::make_shared<std::vector<float>>(r.begin(), r.end()));
+	ExprValue v(n, m);
+	std::copy(r.begin(), r.end(), v.Data());
+	return v;
+}
+
+ExprValue ExprValue::Sum(int dim) const{
+	if (scalar)
+		return *this;
+	return reductionValue(reduction(REDUCE_SUM, dim), dim, f32 != NULL);
+}
+
+ExprValue ExprValue::Mean(int dim) const{
+	if (scalar)
+		return *this;
+	std::vector<double> r = reduction(REDUCE_SUM, dim);
+	double n = dim == REDUCE_ALL ? (double)rows * cols : dim == REDUCE_COLS ? rows : cols;
+	for (double &x : r)
+		x /= n;
+	return reductionValue(r, dim, f32 != NULL);
+}
+
+// Sample variance, with n - 1 in the denominator, from the squared
+// deviations to the mean; 0 for a single element.
+ExprValue ExprValue::Var(int dim) const{
+	if (scalar && im != 0)
+		throw InvalidOperand();
+	if (scalar)
+		return ExprValue();
+	std::vector<double> r = reduction(REDUCE_SUM, dim);
+	double n = dim == REDUCE_ALL ? (double)rows * cols : dim == REDUCE_COLS ? rows : cols;
+	for (double &x : r)
+		x /= n;
+	r = reduction(REDUCE_SQDEV, dim, r.data());
+	for (double &x : r)
+		x = n > 1 ? x / (n - 1) : 0;
+	return reductionValue(r, dim, f32 != NULL);
+}
+
+ExprValue ExprValue::Min(int dim) const{
+	if (scalar && im != 0)
+		throw InvalidOperand();
+	if (scalar)
+		return *this;
+	return reductionValue(reduction(REDUCE_MIN, dim), dim, f32 != NULL);
+}
+
+ExprValue ExprValue::Max(int dim) const{
+	if (scalar && im != 0)
+		throw InvalidOperand();
+	if (scalar)
+		return *this;
+	return reductionValue(reduction(REDUCE_MAX, dim), dim, f32 != NULL);
+}
+
+// Euclidean norm of the whole matrix (Frobenius), of each column or of
+// each row.
+ExprValue ExprValue::Norm(int dim) const{
+	if (scalar)
+		return Abs();
+	std::vector<double> r = products(*this, dim);
+	for (double &x : r)
+		x = sqrt(x);
+	return reductionValue(r, dim, f32 != NULL);
+}
+
+// Sum of the elementwise products; two vectors of the same length need not
+// have the same orientation.
+ExprValue ExprValue::Dot(const ExprValue &rhs, int dim) const{
+	if (scalar && rhs.scalar && im == 0 && rhs.im == 0)
+		return ExprValue(re * rhs.re, 0.);
+	if (scalar || rhs.scalar)
+		throw InvalidOperand();
+	if ((rows != rhs.rows || cols != rhs.cols) && dim == REDUCE_ALL
+		&& (rows == 1 || cols == 1) && rows == rhs.cols && cols == rhs.rows)
+		return Dot(rhs.Trans(), dim);
+	return reductionValue(products(rhs, dim), dim, f32 && rhs.f32);
+}
+
+std::vector<double> ExprValue::products(const ExprValue &rhs, int dim) const{
+	if (rows != rhs.rows || cols != rhs.cols || dim < REDUCE_ALL || dim > REDUCE_ROWS)
+		throw InvalidOperand();
+	if (tiled || rhs.tiled)
+		return (*this * rhs).reduction(REDUCE_SUM, dim);
+	std::vector<double> r(dim == REDUCE_ALL ? 1 : dim == REDUCE_COLS ? cols : rows);
+	if (f32 && rhs.f32)
+		dot(f32->data(), cols, rhs.f32->data(), cols, rows, cols, (ReduceDim)dim, r.data());
+	else{
+		densify();
+		rhs.densify();
+		dot(buf->data() + offset, ld, rhs.buf->data() + rhs.offset, rhs.ld, rows, cols, (ReduceDim)dim, r.data());
+	}
+	return r;
+}
+
+ExprValue ExprValue::Trace() const{
+	if (scalar)
+		return *this;
+	if (rows != cols)
+		throw InvalidOperand();
+	std::vector<double> d(rows);
+	for (int i = 0; i < rows; i++)
+		d[i] = Get(i, i);
+	double t;
+	reduce(d.data(), 1, rows, rows, REDUCE_SUM, REDUCE_ALL, NULL, &t);
+	return ExprValue(t, 0.);
+}
+
+bool ExprValue::fitsInMemory(int rows, int cols){
+	return (size_t)rows * cols * sizeof(double) <= TiledMatrix::memoryLimit();
+}
+
+// A rows x cols matrix filled block by block as by TiledMatrix::generate,
+// rows split across threads; on disk if it is over the memory limit.
+ExprValue ExprValue::generate(int rows, int cols, const TiledMatrix::Fill &fill){
+	if (rows < 1 || cols < 1)
+		throw InvalidOperand();
+	if (!fitsInMemory(rows, cols))
+		return ExprValue(TiledMatrix::generate(rows, cols, fill));
+	ExprValue m(rows, cols);
+	double *a = m.Data();
+	parallelFor(0, rows, GENERATE_GRAIN_ROWS, [&](int from, int to){
+		fill(from, 0, to - from, cols, a + (size_t)from * cols, cols);
+	});
+	return m;
+}
+
+// Buffers and tiles both start out zeroed, so zeros only allocates; on disk
+// not even that, as tiles never written take no space in the scratch file.
+ExprValue ExprValue::Zeros(int rows, int cols){
+	if (rows < 1 || cols < 1)
+		throw InvalidOperand();
+	if (!fitsInMemory(rows, cols))
+		return ExprValue(std::make_shared<TiledMatrix>(rows, cols));
+	ExprValue m(rows, cols);
+	return m.withStructure(rows == cols ? DIAGONAL : GENERAL);
+}
+
+ExprValue ExprValue::Ones(int rows, int cols){
+	ExprValue m = generate(rows, cols, [](int, int, int nrows, int ncols, double *a, int ld){
+		for (int i = 0; i < nrows; i++)
+			std::fill(a + (size_t)i * ld, a + (size_t)i * ld + ncols, 1.);
+	});
+	return m.tiled ? m : m.withStructure(rows == cols ? SYMMETRIC : GENERAL);
+}
+
+ExprValue ExprValue::Eye(int n){
+	if (n < 1)
+		throw InvalidOperand();
+	if (!fitsInMemory(n, n)){
+		std::shared_ptr<TiledMatrix> t = std::make_shared<TiledMatrix>(n, n);
+		for (int k = 0; k < t->tileRows(); k++){
+			std::shared_ptr<TiledMatrix::Tile> tile = t->tile(k, k, true, true);
+			for (int i = 0; i < TILE && k * TILE + i < n; i++)
+				tile->a[i * TILE + i] = 1;
+		}
+		return ExprValue(t);
+	}
+	ExprValue m(n, n);
+	double *a = m.Data();
+	for (int i = 0; i < n; i++)
+		a[(size_t)i * n + i] = 1;
+	return m.withStructure(IDENTITY);
+}
+
+// Element k of the matrices drawn with seed: splitmix64 of a counter, so any
+// block can be filled on its own, by any thread, with the same result.
+static double uniform(unsigned long long seed, unsigned long long k){
+	unsigned long long z = seed * 0xd1b54a32d192ed03ULL + (k + 1) * 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	z ^= z >> 31;
+	return (z >> 11) * (1. / 9007199254740992.);
+}
+
+// Uniform in [0, 1), the same for a given seed and size whether the matrix
+// is in memory or on disk.
+ExprValue ExprValue::Rand(int rows, int cols, long long seed){
+	return generate(rows, cols, [=](int row, int col, int nrows, int ncols, double *a, int ld){
+		for (int i = 0; i < nrows; i++){
+			unsigned long long k = (unsigned long long)(row + i) * cols + col;
+			for (int j = 0; j < ncols; j++)
+				a[(size_t)i * ld + j] = uniform(seed, k + j);
+		}
+	});
+}
+
+// n evenly spaced points from from to to, both included, as a row vector.
+ExprValue ExprValue::Linspace(double from, double to, int n){
+	double step = n > 1 ? (to - from) / (n - 1) : 0;
+	return generate(1, n, [=](int, int col, int, int ncols, double *a, int){
+		for (int j = 0; j < ncols; j++)
+			a[j] = col + j == n - 1 ? to : from + (col + j) * step;
+	});
+}
+
+// start, start + step, ... count elements in all, as a row vector that
+// stores none of them.
+ExprValue ExprValue::Range(double start, double step, int count){
+	if (count < 1)
+		throw InvalidOperand();
+	ExprValue r;
+	r.scalar = false;
+	r.rows = 1;
+	r.cols = r.ld = count;
+	r.range = true;
+	r.rangeStart = start;
+	r.rangeStep = step;
+	return r;
+}
+
 ExprValue::~ExprValue() {}
 
 std::string ExprValue::toString(bool tree) const{
@@ -335,13 +1283,22 @@ std::string ExprValue::toString(bool tree) const{
 		c[0] = re;
 		c[1] = im;
 		ss << printPolynom(c, "i");		
+	}else if (tiled && (size_t)rows * cols * sizeof(double) > TiledMatrix::memoryLimit()){
+		ss << "[ tiled " << rows << " x " << cols << " matrix ]";
+	}else if (range && cols > RANGE_PRINT_ELEMENTS){
+		ss << "[ ";
+		for (int col = 0; col < 3; col++)
+			ss << Get(0, col) << " , ";
+		ss << "... , " << Get(0, cols - 1) << " ]";
 	}else{
+		if (!f32)
+			densify();
 		if(tree)
 			ss << "[";
 		for (int row = 0; row < rows; row++){
 			ss << "[ ";
 			for (int col = 0; col < cols; col++)
-				ss << a[row * cols + col] << (col < cols - 1 ? " , " : "");
+				ss << (f32 ? (*f32)[(size_t)row * cols + col] : at(row, col)) << (col < cols - 1 ? " , " : "");
 			ss << " ]";
 			if (row < rows - 1)
 				ss << (tree ? ";" : "\n  ");
@@ -2,7 +2,20 @@
 #include <sstream>
 #include <iomanip>
 #include <map>
+#include <climits>
 #include "Utils.hpp"
+#include "PolyForm.hpp"
+#include "Derivative.hpp"
+#include "FusedKernel.hpp"
+#include "MatrixChain.hpp"
+#include "MatrixFile.hpp"
+#include "Quadrature.hpp"
+#include "Series.hpp"
+
+#define SOLVE_RCOND_WARNING 1e-10
+#define SERIES_MAX_INDEX 9007199254740992.
+#define SERIES_CLOSED_DEGREE 16
+#define RANGE_ROUNDING 1e-10
 
 const char *Expression::IncorrectExpression::what() const throw()
 {
@@ -15,13 +28,13 @@ Expression::Expression(const std::string &s) : root(NULL)
 {
 	str = s;
 	i = -1;
-	root = readExpression();
+	root = readRange();
 	if (!root)
 		throw IncorrectExpression();
 	char c = getChar();
 	if (c == '=')
 	{
-		exprnode *rhs = readExpression();
+		exprnode *rhs = readRange();
 		if (!rhs)
 		{
 			delete root;
@@ -40,6 +53,12 @@ Expression::Expression(const std::string &s) : root(NULL)
 	collectVars();
 }
 
+// Takes ownership of an already built tree.
+Expression::Expression(exprnode *root) : root(root)
+{
+	collectVars();
+}
+
 void Expression::Reduce()
 {
 	if (root->opcode == '=' && *root->right != ExprValue())
@@ -55,7 +74,17 @@ const std::set<std::string> Expression::getVars() const
 	return vars;
 }
 
-Expression::Expression(const Expression &other)
+const std::vector<std::string> &Expression::getNotes() const
+{
+	return notes;
+}
+
+void Expression::setExplain(bool on)
+{
+	explain = on;
+}
+
+Expression::Expression(const Expression &other) : root(NULL)
 {
 	if (this != &other)
 		*this = other;
@@ -70,6 +99,9 @@ Expression &Expression::operator=(const Expression &other)
 		root = other.root->clone();
 	else
 		root = NULL;
+	vars = other.vars;
+	notes = other.notes;
+	explain = other.explain;
 	return (*this);
 }
 
@@ -92,6 +124,8 @@ void recTreePrint(exprnode *root, int indent, std::stringstream &ss)
 		ss << str_indent << root->value.toString(true) << std::endl;
 	else if (root->opcode == 'v')
 		ss << str_indent << root->varname << std::endl;
+	else if (root->opcode == 's')
+		ss << str_indent << '"' << root->varname << '"' << std::endl;
 	else{
 		recTreePrint(root->right, indent + 1, ss);
 		ss << str_indent << root->opcode << std::endl;
@@ -132,6 +166,24 @@ exprnode *del_ret_null(exprnode *ptr1, exprnode *ptr2 = NULL){
 	return NULL;
 }
 
+// from:to or from:step:to, the ends included; anything else is a plain
+// expression.
+exprnode *Expression::readRange()
+{
+	exprnode *from = readExpression();
+	if (!from || getChar() != ':')
+		return from;
+	exprnode *to = readExpression();
+	if (!to)
+		return del_ret_null(from);
+	if (getChar() != ':')
+		return new exprnode(from, 'r', to);
+	exprnode *last = readExpression();
+	if (!last)
+		return del_ret_null(from, to);
+	return new exprnode(from, 'r', new exprnode(to, ':', last));
+}
+
 exprnode *Expression::readExpression()
 {
 	exprnode *expr = readAddition();
@@ -273,7 +325,13 @@ exprnode *Expression::readVarFunc(){
 		return new exprnode(ExprValue(0., 1.));
 	if (c == '('){
 		exprnode *expr = new exprnode('f', lower(vname));
-		exprnode *arg = readExpression();
+		exprnode *arg = readRange();
+		while (arg && getChar() == ','){
+			exprnode *next = readRange();
+			if (!next)
+				return del_ret_null(expr, arg);
+			arg = new exprnode(arg, ',', next);
+		}
 		if (!arg || getChar() != ')')
 			return del_ret_null(expr, arg);
 		expr->left = arg;
@@ -289,7 +347,7 @@ exprnode *Expression::readPower(){
 	if (std::isalpha(c))
 		expr = readVarFunc();
 	else if (c == '('){
-		expr = readExpression();
+		expr = readRange();
 		c = getChar();
 		if (!expr || c != ')')
 			return del_ret_null(expr);
@@ -304,6 +362,13 @@ exprnode *Expression::readPower(){
 		expr = new exprnode('f', "abs");
 		expr->left = arg;
 		getNextChar();
+	}else if (c == '"'){
+		std::string::size_type end = str.find('"', i + 1);
+		if (end == std::string::npos)
+			return NULL;
+		expr = new exprnode('s', str.substr(i + 1, end - i - 1));
+		i = end;
+		getNextChar();
 	}else if (std::isdigit(c) || c == '.')
 		expr = readConst();
 	else if (c == '-' || c == '+'){
@@ -318,9 +383,46 @@ exprnode *Expression::readPower(){
 			expr = new exprnode(new exprnode(ExprValue(-1., 0.)), '*', nexpr);
 		}
 	}
+	while (expr && getChar() == '[')
+		expr = readIndex(expr);
 	return expr;
 }
 
+// expr[spec, spec]: the '[' node holds the indexed expression on the left and
+// the index list on the right.
+exprnode *Expression::readIndex(exprnode *expr){
+	exprnode *specs = NULL;
+	do{
+		exprnode *spec = readSlice();
+		if (!spec)
+			return del_ret_null(expr, specs);
+		specs = specs ? new exprnode(specs, ',', spec) : spec;
+	} while (getChar() == ',');
+	if (getChar() != ']')
+		return del_ret_null(expr, specs);
+	getNextChar();
+	return new exprnode(expr, '[', specs);
+}
+
+// An index, or a range lo:hi where either end may be left out.
+exprnode *Expression::readSlice(){
+	exprnode *lo = NULL, *hi = NULL;
+	if (getNextChar() != ':'){
+		i--;
+		lo = readExpression();
+		if (!lo || getChar() != ':')
+			return lo;
+	}
+	char c = getNextChar();
+	if (c != ',' && c != ']'){
+		i--;
+		hi = readExpression();
+		if (!hi)
+			return del_ret_null(lo);
+	}
+	return new exprnode(lo, ':', hi);
+}
+
 exprnode *clone(exprnode *root){
 	return root ? root->clone() : root;
 }
@@ -392,57 +494,344 @@ void setConst(exprnode *root, ExprValue val){
 	root->right = NULL;
 }
 
-void Expression::eval(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except)
-{
+// Builtins taking an argument list, by the least and the most arguments
+// they accept; all other functions take exactly one argument.
+const std::map<std::string, std::pair<int, int>> listFuncs{
+	{"solve", {2, 2}}, {"hcat", {1, INT_MAX}}, {"vcat", {1, INT_MAX}}, {"save", {2, 2}},
+	{"sum", {1, 4}}, {"prod", {4, 4}}, {"mean", {1, 2}}, {"var", {1, 2}}, {"min", {1, 2}}, {"max", {1, 2}},
+	{"norm", {1, 2}}, {"dot", {2, 3}}, {"zeros", {1, 2}}, {"ones", {1, 2}}, {"rand", {2, 3}},
+	{"linspace", {3, 3}}, {"integrate", {3, 3}}};
+
+const std::set<std::string> reductions{"sum", "mean", "var", "min", "max", "norm", "dot"};
+const std::set<std::string> constructors{"zeros", "ones", "eye", "rand", "linspace"};
+
+// Reductions over a matrix, the last argument optionally a dimension: 1 for
+// one result per column, 2 for one per row.
+ExprValue reduceArgs(const std::string &name, const std::vector<const ExprValue *> &args){
+	size_t operands = name == "dot" ? 2 : 1;
+	int dim = REDUCE_ALL;
+	if (args.size() > operands + 1)
+		throw ExprValue::InvalidOperand();
+	if (args.size() > operands){
+		const ExprValue &d = *args.back();
+		if (!d.isReal() || (d.Re() != REDUCE_COLS && d.Re() != REDUCE_ROWS))
+			throw ExprValue::InvalidOperand();
+		dim = (int)d.Re();
+	}
+	const ExprValue &a = *args[0];
+	if (name == "sum")
+		return a.Sum(dim);
+	if (name == "mean")
+		return a.Mean(dim);
+	if (name == "var")
+		return a.Var(dim);
+	if (name == "min")
+		return a.Min(dim);
+	if (name == "max")
+		return a.Max(dim);
+	if (name == "norm")
+		return a.Norm(dim);
+	return a.Dot(*args[1], dim);
+}
+
+int sizeArg(const ExprValue &v){
+	if (!v.isReal() || v.Re() != (int)v.Re() || v.Re() < 1 || v.Re() > INT_MAX)
+		throw ExprValue::InvalidOperand();
+	return (int)v.Re();
+}
+
+// zeros(n[, m]), ones(n[, m]), eye(n), rand(n, m[, seed]) and
+// linspace(a, b, n), filled in place instead of parsed from a literal; one
+// size gives a square matrix.
+ExprValue constructArgs(const std::string &name, const std::vector<const ExprValue *> &args){
+	if (name == "linspace"){
+		if (!args[0]->isReal() || !args[1]->isReal())
+			throw ExprValue::InvalidOperand();
+		return ExprValue::Linspace(args[0]->Re(), args[1]->Re(), sizeArg(*args[2]));
+	}
+	int rows = sizeArg(*args[0]), cols = args.size() > 1 ? sizeArg(*args[1]) : rows;
+	if (name == "zeros")
+		return ExprValue::Zeros(rows, cols);
+	if (name == "ones")
+		return ExprValue::Ones(rows, cols);
+	if (name == "eye")
+		return ExprValue::Eye(rows);
+	long long seed = 0;
+	if (args.size() > 2){
+		const ExprValue &v = *args[2];
+		if (!v.isReal() || v.Re() != (long long)v.Re())
+			throw ExprValue::InvalidOperand();
+		seed = (long long)v.Re();
+	}
+	return ExprValue::Rand(rows, cols, seed);
+}
+
+bool constRange(const exprnode *root){
+	const exprnode *rest = root->right;
+	return root->left->opcode == 'c'
+		&& (rest->opcode == ':' ? rest->left->opcode == 'c' && rest->right->opcode == 'c' : rest->opcode == 'c');
+}
+
+// from:to and from:step:to; the count is rounded so that a step such as 0.1
+// still reaches to despite the error of the division.
+ExprValue rangeValue(const exprnode *root){
+	const ExprValue &from = root->left->value;
+	const ExprValue &to = root->right->opcode == ':' ? root->right->right->value : root->right->value;
+	ExprValue step = root->right->opcode == ':' ? root->right->left->value : ExprValue(1., 0.);
+	if (!from.isReal() || !to.isReal() || !step.isReal() || step.Re() == 0)
+		throw ExprValue::InvalidOperand();
+	double count = (to.Re() - from.Re()) / step.Re() + RANGE_ROUNDING;
+	if (!(count >= 0 && count < INT_MAX))
+		throw ExprValue::InvalidOperand();
+	return ExprValue::Range(from.Re(), step.Re(), (int)count + 1);
+}
+
+const std::set<std::string> streamed{"sum", "mean", "var", "min", "max", "norm"};
+const std::set<std::string> streamedFuncs{"sqrt", "exp", "ln", "sin", "cos", "tan", "cot", "atan", "torad", "todeg"};
+
+// 1 for a real number, 2 for an elementwise expression of range, 0 for
+// anything that ExprValue would reject or that is not made of numbers, one
+// range (set on the first one met) and the streamable functions.
+int streamKind(const exprnode *root, const ExprValue *&range){
+	if (root->opcode == 'c' && root->value.isReal())
+		return 1;
+	if (root->opcode == 'c' && root->value.isRange()){
+		const ExprValue &v = root->value;
+		if (range && (v.RangeStart() != range->RangeStart() || v.RangeStep() != range->RangeStep()
+					  || v.Cols() != range->Cols()))
+			return 0;
+		range = &v;
+		return 2;
+	}
+	if (root->opcode == 'f')
+		return streamedFuncs.count(root->varname) ? streamKind(root->left, range) : 0;
+	if (!contains("+-*/^", root->opcode) || !root->left || !root->right)
+		return 0;
+	int l = streamKind(root->left, range), r = streamKind(root->right, range);
+	if (!l || !r)
+		return 0;
+	if (root->opcode == '*')
+		return l > r ? l : r;
+	if (root->opcode == '/')
+		return r == 1 ? l : 0;
+	if (root->opcode == '^')
+		return l == 1 && r == 1 ? 1 : 0;
+	return l == r ? l : 0;
+}
+
+// Range leaves become the variable a streamed body is compiled in, a name
+// no input can spell.
+void rangeToVar(exprnode *root){
 	if (!root)
 		return;
-	eval(root->left, defs, except);
-	eval(root->right, defs, except);
-	if (root->opcode == 'f' && defs.find(lower(root->varname)) != defs.end()){
-		exprnode *arg = root->left;
-		const exprnode *fun = defs[lower(root->varname)]->getRoot();
-		std::string argname = fun->left->left->varname;
-		root->left = NULL;
-		clonereplace(root, fun->right);
-		recsubst(root, argname, arg);
-		delete arg;
+	if (root->opcode == 'c' && root->value.isRange()){
+		root->opcode = 'v';
+		root->varname = "#";
+		root->value = ExprValue();
+	}
+	rangeToVar(root->left);
+	rangeToVar(root->right);
+}
+
+int argCount(const exprnode *arg){
+	return arg->opcode == ',' ? argCount(arg->left) + 1 : 1;
+}
+
+// sum(expr, k, from, to) and prod(expr, k, from, to), as opposed to the
+// reductions of a matrix.
+bool isSeries(exprnode *root){
+	return root->opcode == 'f' && (lower(root->varname) == "sum" || lower(root->varname) == "prod")
+		&& argCount(root->left) == 4 && root->left->left->left->right->opcode == 'v';
+}
+
+// Values of a constant argument list in order, or false if some argument
+// is not constant yet.
+bool constArgs(const exprnode *arg, std::vector<const ExprValue *> &values){
+	if (arg->opcode == ',' && !constArgs(arg->left, values))
+		return false;
+	const exprnode *last = arg->opcode == ',' ? arg->right : arg;
+	if (last->opcode != 'c')
+		return false;
+	values.push_back(&last->value);
+	return true;
+}
+
+bool constIndex(const exprnode *spec){
+	if (spec->opcode == ',')
+		return constIndex(spec->left) && constIndex(spec->right);
+	if (spec->opcode == ':')
+		return (!spec->left || spec->left->opcode == 'c') && (!spec->right || spec->right->opcode == 'c');
+	return spec->opcode == 'c';
+}
+
+int indexValue(const exprnode *node, int size, int open){
+	if (!node)
+		return open;
+	const ExprValue &v = node->value;
+	if (!v.isReal() || v.Re() != (int)v.Re() || v.Re() < 1 || v.Re() > size)
+		throw ExprValue::InvalidOperand();
+	return (int)v.Re() - 1;
+}
+
+// First element and count of one index over a dimension of the given size;
+// single is set for a plain index as opposed to a range.
+void indexRange(const exprnode *spec, int size, int &from, int &count, bool &single){
+	single = spec->opcode != ':';
+	from = indexValue(single ? spec : spec->left, size, 0);
+	count = (single ? from : indexValue(spec->right, size, size - 1)) - from + 1;
+	if (count < 1)
+		throw ExprValue::InvalidOperand();
+}
+
+// m[i, j], m[lo:hi, :] and so on, 1-based with ranges including both ends.
+// A lone index picks an element of a vector and a row of a matrix. Ranges
+// are slices sharing m's elements, plain indices on both sides a number.
+ExprValue indexMatrix(const ExprValue &m, const exprnode *spec){
+	if (!m.isMatrix())
+		throw ExprValue::InvalidOperand();
+	int row = 0, rows = 1, col = 0, cols = 1;
+	bool rowSingle = m.Rows() == 1, colSingle = m.Cols() == 1;
+	if (spec->opcode == ','){
+		if (spec->left->opcode == ',')
+			throw ExprValue::InvalidOperand();
+		indexRange(spec->left, m.Rows(), row, rows, rowSingle);
+		indexRange(spec->right, m.Cols(), col, cols, colSingle);
+	}else if (m.Rows() == 1)
+		indexRange(spec, m.Cols(), col, cols, colSingle);
+	else{
+		indexRange(spec, m.Rows(), row, rows, rowSingle);
+		cols = m.Cols();
+	}
+	if (rowSingle && colSingle)
+		return ExprValue(m.Get(row, col), 0.);
+	return m.Slice(row, rows, col, cols);
+}
+
+void Expression::evalLeaves(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except)
+{
+	if (!FusedKernel::isElementwise(root))
+		return eval(root, defs, except);
+	evalLeaves(root->left, defs, except);
+	evalLeaves(root->right, defs, except);
+}
+
+// Chains of elementwise matrix operations are run as one fused loop instead
+// of one temporary matrix per operator. Only tried at the root of a maximal
+// elementwise region; if the region turns out not to be fusable, the
+// ordinary walk below folds it without trying its subregions again. Its
+// leaves are constants or already evaluated by then.
+bool Expression::evalFused(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except)
+{
+	if (FusedKernel::countOps(root) < 2)
+		return false;
+	evalLeaves(root, defs, except);
+	FusedKernel kernel;
+	if (!kernel.compile(root))
+		return false;
+	setConst(root, kernel.run());
+	return true;
+}
+
+void collectChain(exprnode *root, std::vector<exprnode *> &factors)
+{
+	if (root->opcode != 'm')
+		return factors.push_back(root);
+	collectChain(root->left, factors);
+	collectChain(root->right, factors);
+}
+
+// a ** b ** c is parsed left to right; once the shapes of three or more
+// factors are known the product is reordered to the cheapest parenthesization.
+bool Expression::evalChain(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except)
+{
+	if (root->opcode != 'm' || root->left->opcode != 'm')
+		return false;
+	std::vector<exprnode *> leaves;
+	collectChain(root, leaves);
+	std::vector<const ExprValue *> factors;
+	for (exprnode *leaf : leaves){
+		eval(leaf, defs, except);
+		if (leaf->opcode != 'c' || !leaf->value.isMatrix())
+			return false;
+		factors.push_back(&leaf->value);
+	}
+	for (size_t i = 1; i < factors.size(); i++)
+		if (factors[i - 1]->Cols() != factors[i]->Rows())
+			return false;
+	MatrixChain chain(factors);
+	if (explain){
+		std::stringstream ss;
+		ss << "Matrix chain " << chain.shapes() << ": " << chain.plan() << ", " << chain.cost() << " flops";
+		if (chain.cost() < chain.naiveCost())
+			ss << " instead of " << chain.naiveCost() << " left to right";
+		notes.push_back(ss.str());
+	}
+	setConst(root, chain.multiply());
+	return true;
+}
+
+void Expression::streamLeaves(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except)
+{
+	if (contains("+-*/^", root->opcode) && root->left && root->right){
+		streamLeaves(root->left, defs, except);
+		streamLeaves(root->right, defs, except);
+	}else if (root->opcode == 'f' && streamedFuncs.count(root->varname))
+		streamLeaves(root->left, defs, except);
+	else
 		eval(root, defs, except);
+}
+
+// A reduction of an elementwise expression of a range, such as
+// sum(sin(x)) with x = 1:1000000, is compiled and run over the range a
+// block at a time, so that neither the range nor the expression's values
+// are ever stored. Anything else is left to the ordinary walk.
+bool Expression::evalStreamed(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except)
+{
+	if (root->opcode != 'f' || !streamed.count(lower(root->varname)) || root->left->opcode == ',')
+		return false;
+	streamLeaves(root->left, defs, except);
+	const ExprValue *range = NULL;
+	if (root->left->opcode == 'c' || streamKind(root->left, range) != 2)
+		return false;
+	exprnode *body = root->left->clone();
+	rangeToVar(body);
+	ExprProgram program;
+	bool compiled = program.compile(body, "#");
+	delete body;
+	if (!compiled)
+		return false;
+	std::string name = lower(root->varname);
+	double start = range->RangeStart(), step = range->RangeStep(), n = range->Cols(), r;
+	if (name == "min" || name == "max")
+		r = sequenceReduce(program, start, step, n, name == "min" ? REDUCE_MIN : REDUCE_MAX, 0);
+	else if (name == "norm")
+		r = sqrt(sequenceReduce(program, start, step, n, REDUCE_SQDEV, 0));
+	else{
+		r = sequenceReduce(program, start, step, n, REDUCE_SUM, 0);
+		if (name != "sum")
+			r /= n;
+		if (name == "var")
+			r = n > 1 ? sequenceReduce(program, start, step, n, REDUCE_SQDEV, r) / (n - 1) : 0;
 	}
-	if (root->opcode == 'v' && lower(root->varname) != except && defs.find(lower(root->varname)) != defs.end())
-		clonereplace(root, defs[lower(root->varname)]->getRoot()->right);
-	ReduceConstants(root);
-	if (root->opcode == 'f' && lower(root->varname) == "abs" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Abs());
-	else if (root->opcode == 'f' && lower(root->varname) == "sqrt" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Sqrt());
-	else if (root->opcode == 'f' && lower(root->varname) == "exp" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Exp());
-	else if (root->opcode == 'f' && lower(root->varname) == "ln" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Ln());
-	else if (root->opcode == 'f' && lower(root->varname) == "sin" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Sin());
-	else if (root->opcode == 'f' && lower(root->varname) == "cos" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Cos());
-	else if (root->opcode == 'f' && lower(root->varname) == "tan" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Tan());
-	else if (root->opcode == 'f' && lower(root->varname) == "cot" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Cot());
-	else if (root->opcode == 'f' && lower(root->varname) == "atan" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Atan());
-	else if (root->opcode == 'f' && lower(root->varname) == "torad" && root->left->opcode == 'c')
-		setConst(root, root->left->value.DegToRad());
-	else if (root->opcode == 'f' && lower(root->varname) == "todeg" && root->left->opcode == 'c')
-		setConst(root, root->left->value.RadToDeg());
-	else if (root->opcode == 'f' && lower(root->varname) == "det" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Det());
-	else if (root->opcode == 'f' && lower(root->varname) == "cof" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Cof());
-	else if (root->opcode == 'f' && lower(root->varname) == "trans" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Trans());
-	else if (root->opcode == 'f' && lower(root->varname) == "adj" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Adj());
-	else if (root->opcode == 'f' && lower(root->varname) == "inv" && root->left->opcode == 'c')
-		setConst(root, root->left->value.Inv());
+	if (r != r)
+		throw DomainError();
+	if (explain){
+		std::stringstream ss;
+		ss << "Streamed " << name << " over a range of " << n << " elements";
+		notes.push_back(ss.str());
+	}
+	setConst(root, ExprValue(r, 0.));
+	return true;
+}
+
+// Indexing, ranges, named constants and operators on constants, and the
+// identities that drop a 0 or 1 operand.
+void foldConstants(exprnode *root)
+{
+	if (root->opcode == '[' && root->left->opcode == 'c' && constIndex(root->right))
+		setConst(root, indexMatrix(root->left->value, root->right));
+	else if (root->opcode == 'r' && constRange(root))
+		setConst(root, rangeValue(root));
 	else if (root->opcode == 'v' && lower(root->varname) == "pi")
 		setConst(root, ExprValue(FT_PI, 0.));
 	else if (root->opcode == 'v' && lower(root->varname) == "e")
@@ -477,13 +866,218 @@ void Expression::eval(exprnode *root, std::map<std::string, Expression *> &defs,
 		clonereplace(root, root->left);
 }
 
+// fuse is false below the root of an elementwise region, which evalFused
+// has tried as a whole already.
+void Expression::eval(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except, bool fuse)
+{
+	if (!root)
+		return;
+	if ((fuse && evalFused(root, defs, except)) || evalChain(root, defs, except))
+		return;
+	if (isSeries(root))
+		return evalSeries(root, defs, except);
+	if (evalStreamed(root, defs, except))
+		return;
+	fuse = !FusedKernel::isElementwise(root);
+	eval(root->left, defs, except, fuse);
+	eval(root->right, defs, except, fuse);
+	if (root->opcode == 'f'){
+		auto list = listFuncs.find(lower(root->varname));
+		if (list != listFuncs.end() ? argCount(root->left) < list->second.first || argCount(root->left) > list->second.second
+									: root->left->opcode == ',')
+			throw IncorrectExpression();
+	}
+	if (root->opcode == 'f' && defs.find(lower(root->varname)) != defs.end()){
+		exprnode *arg = root->left;
+		const exprnode *fun = defs[lower(root->varname)]->getRoot();
+		std::string argname = fun->left->left->varname;
+		root->left = NULL;
+		clonereplace(root, fun->right);
+		recsubst(root, argname, arg);
+		delete arg;
+		eval(root, defs, except);
+	}
+	if (root->opcode == 'v' && lower(root->varname) != except && defs.find(lower(root->varname)) != defs.end())
+		clonereplace(root, defs[lower(root->varname)]->getRoot()->right);
+	ReduceConstants(root);
+	if (root->opcode == 'f')
+		evalFunction(root, defs, except);
+	else
+		foldConstants(root);
+}
+
+// Builtins of one constant argument that map it to their value.
+const std::map<std::string, ExprValue (ExprValue::*)() const> unaryFuncs{
+	{"tiled", &ExprValue::Tiled}, {"dense", &ExprValue::Dense}, {"float", &ExprValue::F32},
+	{"double", &ExprValue::F64}, {"trace", &ExprValue::Trace}, {"abs", &ExprValue::Abs},
+	{"sqrt", &ExprValue::Sqrt}, {"exp", &ExprValue::Exp}, {"ln", &ExprValue::Ln},
+	{"sin", &ExprValue::Sin}, {"cos", &ExprValue::Cos}, {"tan", &ExprValue::Tan},
+	{"cot", &ExprValue::Cot}, {"atan", &ExprValue::Atan}, {"torad", &ExprValue::DegToRad},
+	{"todeg", &ExprValue::RadToDeg}, {"cof", &ExprValue::Cof}, {"trans", &ExprValue::Trans},
+	{"eig", &ExprValue::Eig}, {"eigvec", &ExprValue::EigVec}};
+
+// The builtin functions, once their arguments are evaluated. Kept out of
+// eval, whose frame is on the stack once per level of the tree.
+void Expression::evalFunction(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except)
+{
+	std::string name = lower(root->varname);
+	auto unary = unaryFuncs.find(name);
+	if (unary != unaryFuncs.end()){
+		if (root->left->opcode == 'c')
+			setConst(root, (root->left->value.*unary->second)());
+	}
+	else if (name == "diff"){
+		std::set<std::string> argvars;
+		std::swap(vars, argvars);
+		collectVars(root->left);
+		std::swap(vars, argvars);
+		if (argvars.size() > 1)
+			throw DomainError();
+		exprnode *d = argvars.empty() ? new exprnode(ExprValue()) : derivative(root->left, *argvars.begin());
+		clonereplace(root, d);
+		delete d;
+		eval(root, defs, except);
+	}
+	else if (name == "integrate"){
+		if (root->left->left->right->opcode == 'c' && root->left->right->opcode == 'c')
+			evalIntegral(root, except);
+	}
+	else if (name == "solve" && root->left->left->opcode == 'c' && root->left->right->opcode == 'c'){
+		double rcond;
+		ExprValue x = root->left->left->value.Solve(root->left->right->value, rcond);
+		if (rcond < SOLVE_RCOND_WARNING){
+			std::stringstream ss;
+			ss << "Warning: matrix is near singular, condition number estimate " << 1 / rcond;
+			notes.push_back(ss.str());
+		}
+		setConst(root, x);
+	}
+	else if (name == "load" && root->left->opcode == 's')
+		setConst(root, loadMatrix(root->left->varname));
+	else if (name == "save" && root->left->left->opcode == 'c' && root->left->right->opcode == 's')
+		setConst(root, ExprValue((double)saveMatrix(root->left->left->value, root->left->right->varname), 0.));
+	else if (name == "hcat" || name == "vcat"){
+		std::vector<const ExprValue *> parts;
+		if (constArgs(root->left, parts))
+			setConst(root, ExprValue::Concat(parts, name == "hcat"));
+	}
+	else if (reductions.count(name)){
+		std::vector<const ExprValue *> args;
+		if (constArgs(root->left, args))
+			setConst(root, reduceArgs(name, args));
+	}
+	else if (constructors.count(name)){
+		std::vector<const ExprValue *> args;
+		if (constArgs(root->left, args))
+			setConst(root, constructArgs(name, args));
+	}
+	else if (name == "det" && root->left->opcode == 'c'){
+		std::string exact;
+		setConst(root, root->left->value.Det(isResult(root) ? &exact : NULL));
+		if (!exact.empty())
+			notes.push_back("Exact: " + exact);
+	}
+	else if ((name == "adj" || name == "inv") && root->left->opcode == 'c'){
+		std::string exact;
+		const ExprValue &m = root->left->value;
+		std::string *note = isResult(root) ? &exact : NULL;
+		setConst(root, name == "adj" ? m.Adj(note) : m.Inv(note));
+		if (!exact.empty())
+			notes.push_back("Exact:\n  " + exact);
+	}
+}
+
+// The sum or product of a body over an integer index. Polynomial summands
+// have a closed form; any other body is compiled and run over the range.
+// Bodies with variables besides the index wait for their values.
+void Expression::evalSeries(exprnode *root, std::map<std::string, Expression *> &defs, const std::string &except)
+{
+	// the index is bound in the arguments: a definition of the same name
+	// outside is not substituted into them
+	std::map<std::string, Expression *> frame = defs;
+	frame.erase(lower(root->left->left->left->right->varname));
+	eval(root->left, frame, except);
+	exprnode *body = root->left->left->left->left, *from = root->left->left->right, *to = root->left->right;
+	std::string index = root->left->left->left->right->varname;
+	if (from->opcode != 'c' || to->opcode != 'c')
+		return;
+	for (const ExprValue *v : {&from->value, &to->value})
+		if (!v->isReal() || v->Re() != (long long)v->Re() || abs(v->Re()) > SERIES_MAX_INDEX)
+			throw ExprValue::InvalidOperand();
+	long long first = (long long)from->value.Re(), last = (long long)to->value.Re();
+	std::set<std::string> argvars;
+	std::swap(vars, argvars);
+	collectVars(body);
+	std::swap(vars, argvars);
+	argvars.erase(index);
+	if (!argvars.empty())
+		return;
+	bool product = lower(root->varname) == "prod";
+	DensePoly p;
+	std::string varname = index;
+	double r;
+	if (!product && DensePoly::fromTree(body, p, varname) && p.isReal() && p.degree() <= SERIES_CLOSED_DEGREE)
+		r = polynomialSum(p, first, last);
+	else{
+		ExprProgram program;
+		if (!program.compile(body, index))
+			throw DomainError();
+		r = product ? seriesProduct(program, first, last) : seriesSum(program, first, last);
+	}
+	if (r != r)
+		throw DomainError();
+	setConst(root, ExprValue(r, 0.));
+}
+
+// integrate(f, a, b): f is an expression in at most one variable, or the
+// name of a function of one, whose body has replaced it by now. Inside a
+// definition f may also use the argument, which waits for a value.
+void Expression::evalIntegral(exprnode *root, const std::string &except)
+{
+	exprnode *f = root->left->left->left;
+	const ExprValue &a = root->left->left->right->value, &b = root->left->right->value;
+	if (!a.isReal() || !b.isReal())
+		throw ExprValue::InvalidOperand();
+	std::set<std::string> argvars;
+	std::swap(vars, argvars);
+	collectVars(f);
+	std::swap(vars, argvars);
+	if (argvars.size() > 1 && argvars.count(except))
+		return;
+	ExprProgram program;
+	if (argvars.size() > 1 || !program.compile(f, argvars.empty() ? "" : *argvars.begin()))
+		throw DomainError();
+	Quadrature q = integrate(program, a.Re(), b.Re());
+	if (q.value != q.value)
+		throw DomainError();
+	setConst(root, ExprValue(q.value, 0.));
+	std::stringstream ss;
+	ss << std::setprecision(2) << "Error estimate: " << q.error << ", " << q.evaluations << " evaluations over "
+	   << q.intervals << (q.intervals > 1 ? " subintervals" : " subinterval");
+	notes.push_back(ss.str());
+	if (!q.converged)
+		notes.push_back("Warning: requested accuracy not reached");
+}
+
+// The node whose value is the answer: the whole expression, or the right
+// side of an assignment. Notes about intermediate values stay off.
+bool Expression::isResult(const exprnode *node) const{
+	return node == root || (root->opcode == '=' && node == root->right);
+}
+
 void Expression::Evaluate(std::map<std::string, Expression *> &defs)
 {
 	std::string empty = "";
+	notes.clear();
 	eval(root, defs, empty);
+	PolyForm::normalize(root);
+	collectVars();
 }
 
 void Expression::EvaluateRight(std::map<std::string, Expression *> &defs, const std::string &except)
 {
+	notes.clear();
 	eval(root->right, defs, except);
+	PolyForm::normalize(root->right);
+	collectVars();
 }
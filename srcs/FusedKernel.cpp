@@ -0,0 +1,143 @@
+#include "FusedKernel.hpp"
+#include "Utils.hpp"
+#include "Parallel.hpp"
+
+#define FUSED_CHUNK 1024
+#define FUSED_PARALLEL_CHUNKS 16
+
+FusedKernel::FusedKernel(){}
+
+bool FusedKernel::isElementwise(const exprnode *root){
+	return root && contains("+-*/", root->opcode) && root->left && root->right;
+}
+
+int FusedKernel::countOps(const exprnode *root){
+	if (!isElementwise(root))
+		return 0;
+	return 1 + countOps(root->left) + countOps(root->right);
+}
+
+// Scalar-only subtrees are folded here with the usual complex arithmetic;
+// every operation involving a matrix becomes an instruction. Combinations
+// that ExprValue rejects (matrix + scalar, complex factors, shape
+// mismatches) make compile() fail so the caller falls back to it, as do
+// tiled and float matrices, which ExprValue combines tile by tile or with
+// its float kernels.
+bool FusedKernel::emit(const exprnode *root, int depth, Operand &res, ExprValue &scalar){
+	if (!isElementwise(root)){
+		if (root->opcode != 'c' || root->value.isTiled() || root->value.isF32())
+			return false;
+		if (root->value.isComplex()){
+			scalar = root->value;
+			res = {SCALAR, 0, 0};
+			return true;
+		}
+		if (rows == 0){
+			rows = root->value.Rows();
+			cols = root->value.Cols();
+		}else if (rows != root->value.Rows() || cols != root->value.Cols())
+			return false;
+		res = {INPUT, (int)inputs.size(), 0};
+		inputs.push_back(root->value.Data());
+		return true;
+	}
+	Operand x, y;
+	ExprValue xs, ys;
+	if (!emit(root->left, depth, x, xs) || !emit(root->right, depth + 1, y, ys))
+		return false;
+	if (x.kind == SCALAR && y.kind == SCALAR){
+		switch (root->opcode){
+		case '+':
+			scalar = xs + ys;
+			break;
+		case '-':
+			scalar = xs - ys;
+			break;
+		case '*':
+			scalar = xs * ys;
+			break;
+		default:
+			scalar = xs / ys;
+		}
+		res = {SCALAR, 0, 0};
+		return true;
+	}
+	bool valid = (x.kind != SCALAR && y.kind != SCALAR && root->opcode != '/')
+				 || (root->opcode == '*' && x.kind == SCALAR && xs.isReal())
+				 || (contains("*/", root->opcode) && y.kind == SCALAR && ys.isReal());
+	if (!valid)
+		return false;
+	if (x.kind == SCALAR)
+		x.value = xs.Re();
+	if (y.kind == SCALAR)
+		y.value = ys.Re();
+	code.push_back({root->opcode, x, y, depth});
+	if (depth + 1 > ntemps)
+		ntemps = depth + 1;
+	res = {TEMP, depth, 0};
+	return true;
+}
+
+bool FusedKernel::compile(const exprnode *root){
+	inputs.clear();
+	code.clear();
+	rows = cols = ntemps = 0;
+	Operand res;
+	ExprValue scalar;
+	return emit(root, 0, res, scalar) && res.kind == TEMP;
+}
+
+template <typename Op>
+void apply(double *d, const double *x, double xs, const double *y, double ys, int n, Op op){
+	if (x && y)
+		for (int k = 0; k < n; k++)
+			d[k] = op(x[k], y[k]);
+	else if (x)
+		for (int k = 0; k < n; k++)
+			d[k] = op(x[k], ys);
+	else
+		for (int k = 0; k < n; k++)
+			d[k] = op(xs, y[k]);
+}
+
+// The last instruction writes straight into the output.
+void FusedKernel::runChunk(int from, int to, std::vector<double> &temps, double *out) const{
+	int n = to - from;
+	auto operand = [&](const Operand &o) -> const double * {
+		if (o.kind == INPUT)
+			return inputs[o.index] + from;
+		if (o.kind == TEMP)
+			return temps.data() + o.index * FUSED_CHUNK;
+		return NULL;
+	};
+	for (size_t i = 0; i < code.size(); i++){
+		const Instr &in = code[i];
+		double *d = i + 1 == code.size() ? out + from : temps.data() + in.dst * FUSED_CHUNK;
+		const double *x = operand(in.x), *y = operand(in.y);
+		switch (in.opcode){
+		case '+':
+			apply(d, x, in.x.value, y, in.y.value, n, [](double p, double q){ return p + q; });
+			break;
+		case '-':
+			apply(d, x, in.x.value, y, in.y.value, n, [](double p, double q){ return p - q; });
+			break;
+		case '*':
+			apply(d, x, in.x.value, y, in.y.value, n, [](double p, double q){ return p * q; });
+			break;
+		default:
+			apply(d, x, in.x.value, y, in.y.value, n, [](double p, double q){ return p / q; });
+		}
+	}
+}
+
+ExprValue FusedKernel::run() const{
+	ExprValue r(rows, cols);
+	int size = rows * cols, chunks = (size + FUSED_CHUNK - 1) / FUSED_CHUNK;
+	double *out = r.Data();
+	parallelFor(0, chunks, FUSED_PARALLEL_CHUNKS, [&](int from, int to){
+		std::vector<double> temps(ntemps * FUSED_CHUNK);
+		for (int c = from; c < to; c++)
+			runChunk(c * FUSED_CHUNK, min((c + 1) * FUSED_CHUNK, size), temps, out);
+	});
+	return r;
+}
@@ -0,0 +1,839 @@
+#include "Linalg.hpp"
+#include "Utils.hpp"
+#include "Parallel.hpp"
+
+#define SCHUR_MAX_ITERATIONS 60
+#define SCHUR_EXCEPTIONAL_SHIFT 10
+#define BALANCE_GAIN 0.95
+#define LU_BLOCK 64
+#define CHOLESKY_BLOCK 64
+#define PARALLEL_GRAIN_ROWS 32
+#define TRANSPOSE_BLOCK 32
+#define INVNORM_MAX_ITERATIONS 5
+#define SYMMETRIC_QR_MAX_ITERATIONS 30
+#define INVERSE_ITERATIONS 2
+#define EPSILON 2.220446049250313e-16
+
+// Scales rows and columns by powers of two so that their norms are comparable,
+// which keeps the eigenvalues of badly scaled (e.g. companion) matrices accurate.
+// The result is D^-1 A D; if scale is not NULL it receives the diagonal of D.
+void balance(double *a, int n, double *scale){
+	if (scale)
+		std::fill(scale, scale + n, 1.);
+	for (bool changed = true; changed;){
+		changed = false;
+		for (int i = 0; i < n; i++){
+			double c = 0, r = 0;
+			for (int j = 0; j < n; j++)
+				if (j != i){
+					c += abs(a[j * n + i]);
+					r += abs(a[i * n + j]);
+				}
+			if (c == 0 || r == 0)
+				continue;
+			// the power of two f that brings c * f and r / f within a factor
+			// of two of each other; exact, so no rounding is introduced
+			double f = 1;
+			while (c * f * f * 2 < r)
+				f *= 2;
+			while (c * f * f > r * 2)
+				f /= 2;
+			if (c * f + r / f >= BALANCE_GAIN * (c + r))
+				continue;
+			changed = true;
+			for (int j = 0; j < n; j++){
+				a[i * n + j] /= f;
+				a[j * n + i] *= f;
+			}
+			if (scale)
+				scale[i] *= f;
+		}
+	}
+}
+
+// Householder reflector P = I - beta v v^T with P x = (alpha, 0, ...) for the
+// m <= 3 entries of x; v is returned in x. False when x is already zero.
+static bool reflector(double *x, int m, double &beta){
+	double norm = 0;
+	for (int i = 0; i < m; i++)
+		norm += x[i] * x[i];
+	if (norm == 0)
+		return false;
+	double alpha = x[0] >= 0 ? -sqrt(norm) : sqrt(norm);
+	norm -= x[0] * x[0];
+	x[0] -= alpha;
+	beta = 2 / (norm + x[0] * x[0]);
+	return true;
+}
+
+// The two eigenvalues of [[a, b], [c, d]]; a real pair is returned with
+// im = 0 in both, a complex pair as re +- i im.
+static void eigen2(double a, double b, double c, double d, double *re, double *im){
+	double p = (a - d) / 2, disc = p * p + b * c, mid = (a + d) / 2;
+	if (disc < 0){
+		re[0] = re[1] = mid;
+		im[0] = sqrt(-disc);
+		im[1] = -im[0];
+		return;
+	}
+	// the root of larger modulus first, the other one from the determinant
+	double root = sqrt(disc), big = mid >= 0 ? mid + root : mid - root;
+	re[0] = big;
+	re[1] = big != 0 ? (a * d - b * c) / big : mid - root;
+	im[0] = im[1] = 0;
+}
+
+// Eigenvalues of an upper Hessenberg matrix by Francis' implicit double-shift
+// QR steps (Golub and Van Loan, Matrix Computations, 7.5). The active block
+// [lo, hi] shrinks from the bottom as subdiagonal entries become negligible;
+// each step chases a 3 x 3 bulge down the block with Householder reflectors.
+// A complex pair is stored in two adjacent entries. The matrix is
+// destroyed; returns false if some eigenvalue did not converge.
+bool schurEigenvalues(double *a, int n, double *wr, double *wi){
+	auto A = [a, n](int i, int j) -> double & { return a[i * n + j]; };
+	double norm = 0;
+	for (int i = 0; i < n; i++)
+		for (int j = max(i - 1, 0); j < n; j++)
+			norm += abs(A(i, j));
+	int its = 0;
+	for (int hi = n - 1; hi >= 0;){
+		int lo = hi;
+		for (; lo > 0; lo--){
+			double s = abs(A(lo - 1, lo - 1)) + abs(A(lo, lo));
+			if (abs(A(lo, lo - 1)) <= EPSILON * (s != 0 ? s : norm)){
+				A(lo, lo - 1) = 0;
+				break;
+			}
+		}
+		if (lo >= hi - 1){
+			if (lo == hi){
+				wr[hi] = A(hi, hi);
+				wi[hi] = 0;
+			}else
+				eigen2(A(lo, lo), A(lo, hi), A(hi, lo), A(hi, hi), wr + lo, wi + lo);
+			hi = lo - 1;
+			its = 0;
+			continue;
+		}
+		if (its++ == SCHUR_MAX_ITERATIONS)
+			return false;
+		// the shifts are the eigenvalues of the trailing 2 x 2 block, given by
+		// its trace and determinant; now and then an ad hoc pair breaks cycles
+		double tr, det;
+		if (its % SCHUR_EXCEPTIONAL_SHIFT == 0){
+			double s = abs(A(hi, hi - 1)) + abs(A(hi - 1, hi - 2)), h = A(hi, hi) + 0.75 * s;
+			tr = 2 * h;
+			det = h * h + 0.4375 * s * s;
+		}else{
+			tr = A(hi - 1, hi - 1) + A(hi, hi);
+			det = A(hi - 1, hi - 1) * A(hi, hi) - A(hi - 1, hi) * A(hi, hi - 1);
+		}
+		// first column of (H - s1 I)(H - s2 I) = H^2 - tr H + det I
+		double x[3] = {
+			A(lo, lo) * A(lo, lo) + A(lo, lo + 1) * A(lo + 1, lo) - tr * A(lo, lo) + det,
+			A(lo + 1, lo) * (A(lo, lo) + A(lo + 1, lo + 1) - tr),
+			A(lo + 1, lo) * A(lo + 2, lo + 1)};
+		for (int k = lo; k < hi; k++){
+			int m = k < hi - 1 ? 3 : 2;
+			double beta;
+			if (k > lo){
+				for (int i = 0; i < m; i++)
+					x[i] = A(k + i, k - 1);
+			}
+			if (!reflector(x, m, beta))
+				continue;
+			for (int j = max(k - 1, lo); j <= hi; j++){
+				double s = 0;
+				for (int i = 0; i < m; i++)
+					s += x[i] * A(k + i, j);
+				s *= beta;
+				for (int i = 0; i < m; i++)
+					A(k + i, j) -= s * x[i];
+			}
+			for (int i = lo; i <= min(k + 3, hi); i++){
+				double s = 0;
+				for (int j = 0; j < m; j++)
+					s += A(i, k + j) * x[j];
+				s *= beta;
+				for (int j = 0; j < m; j++)
+					A(i, k + j) -= s * x[j];
+			}
+			// the bulge below the subdiagonal is gone up to rounding
+			if (k > lo)
+				for (int i = 1; i < m; i++)
+					A(k + i, k - 1) = 0;
+		}
+	}
+	return true;
+}
+
+// In-place Cholesky factorization A = L L^T of a symmetric matrix; only the
+// lower triangle is read and written. Rows below each block column are
+// independent once the diagonal block is done, so they are split between
+// threads. Returns false if A is not positive definite.
+bool cholesky(double *a, int n){
+	auto A = [a, n](int i, int j) -> double & { return a[i * n + j]; };
+	auto update = [a, n](int i, int j){
+		double s = a[i * n + j];
+		const double *li = a + i * n, *lj = a + j * n;
+		for (int k = 0; k < j; k++)
+			s -= li[k] * lj[k];
+		return s;
+	};
+	for (int j0 = 0; j0 < n; j0 += CHOLESKY_BLOCK){
+		int j1 = min(j0 + CHOLESKY_BLOCK, n);
+		for (int i = j0; i < j1; i++){
+			for (int j = j0; j < i; j++)
+				A(i, j) = update(i, j) / A(j, j);
+			double d = update(i, i);
+			if (!(d > 0))
+				return false;
+			A(i, i) = sqrt(d);
+		}
+		parallelFor(j1, n, PARALLEL_GRAIN_ROWS, [&](int from, int to){
+			for (int i = from; i < to; i++)
+				for (int j = j0; j < j1; j++)
+					A(i, j) = update(i, j) / A(j, j);
+		});
+	}
+	return true;
+}
+
+// Solves L L^T X = B for the n x nrhs row-major B in place.
+void choleskySolve(const double *l, int n, double *b, int nrhs){
+	for (int i = 0; i < n; i++){
+		double *bi = b + i * nrhs;
+		for (int k = 0; k < i; k++)
+			for (int c = 0; c < nrhs; c++)
+				bi[c] -= l[i * n + k] * b[k * nrhs + c];
+		for (int c = 0; c < nrhs; c++)
+			bi[c] /= l[i * n + i];
+	}
+	for (int i = n - 1; i >= 0; i--){
+		double *bi = b + i * nrhs;
+		for (int c = 0; c < nrhs; c++)
+			bi[c] /= l[i * n + i];
+		for (int k = 0; k < i; k++)
+			for (int c = 0; c < nrhs; c++)
+				b[k * nrhs + c] -= l[i * n + k] * bi[c];
+	}
+}
+
+// In-place LU factorization with partial pivoting, PA = LU with unit lower L.
+// perm[i] is the row of A that ended up in row i. Right-looking and blocked:
+// each panel is factored on its own, then the trailing matrix gets one rank-
+// LU_BLOCK update split by rows between threads. Returns false on an exactly
+// zero pivot.
+bool lu(double *a, int n, int *perm){
+	auto A = [a, n](int i, int j) -> double & { return a[i * n + j]; };
+	for (int i = 0; i < n; i++)
+		perm[i] = i;
+	for (int k0 = 0; k0 < n; k0 += LU_BLOCK){
+		int k1 = min(k0 + LU_BLOCK, n);
+		for (int k = k0; k < k1; k++){
+			int p = k;
+			for (int i = k + 1; i < n; i++)
+				if (abs(A(i, k)) > abs(A(p, k)))
+					p = i;
+			if (A(p, k) == 0)
+				return false;
+			if (p != k){
+				std::swap_ranges(a + p * n, a + p * n + n, a + k * n);
+				std::swap(perm[p], perm[k]);
+			}
+			for (int i = k + 1; i < n; i++){
+				double m = A(i, k) /= A(k, k);
+				for (int j = k + 1; j < k1; j++)
+					A(i, j) -= m * A(k, j);
+			}
+		}
+		for (int k = k0; k < k1; k++)
+			for (int i = k + 1; i < k1; i++){
+				double m = A(i, k);
+				for (int j = k1; j < n; j++)
+					A(i, j) -= m * A(k, j);
+			}
+		parallelFor(k1, n, PARALLEL_GRAIN_ROWS, [&](int from, int to){
+			for (int i = from; i < to; i++)
+				for (int k = k0; k < k1; k++){
+					double m = A(i, k);
+					if (m == 0)
+						continue;
+					for (int j = k1; j < n; j++)
+						A(i, j) -= m * A(k, j);
+				}
+		});
+	}
+	return true;
+}
+
+// Solves A X = B for the n x nrhs row-major B in place.
+void luSolve(const double *lu, int n, const int *perm, double *b, int nrhs){
+	std::vector<double> pb(b, b + n * nrhs);
+	for (int i = 0; i < n; i++)
+		std::copy(pb.begin() + perm[i] * nrhs, pb.begin() + perm[i] * nrhs + nrhs, b + i * nrhs);
+	for (int i = 0; i < n; i++){
+		double *bi = b + i * nrhs;
+		for (int k = 0; k < i; k++)
+			for (int c = 0; c < nrhs; c++)
+				bi[c] -= lu[i * n + k] * b[k * nrhs + c];
+	}
+	for (int i = n - 1; i >= 0; i--){
+		double *bi = b + i * nrhs;
+		for (int k = i + 1; k < n; k++)
+			for (int c = 0; c < nrhs; c++)
+				bi[c] -= lu[i * n + k] * b[k * nrhs + c];
+		for (int c = 0; c < nrhs; c++)
+			bi[c] /= lu[i * n + i];
+	}
+}
+
+// Solves A^T x = b for a single vector in place: U^T L^T P x = b.
+void luSolveTrans(const double *lu, int n, const int *perm, double *b){
+	for (int i = 0; i < n; i++){
+		b[i] /= lu[i * n + i];
+		for (int j = i + 1; j < n; j++)
+			b[j] -= lu[i * n + j] * b[i];
+	}
+	for (int i = n - 1; i >= 0; i--)
+		for (int j = 0; j < i; j++)
+			b[j] -= lu[i * n + j] * b[i];
+	std::vector<double> v(b, b + n);
+	for (int i = 0; i < n; i++)
+		b[perm[i]] = v[i];
+}
+
+double norm1(const double *a, int n){
+	std::vector<double> colsum(n, 0.);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			colsum[j] += abs(a[i * n + j]);
+	double r = 0;
+	for (int j = 0; j < n; j++)
+		if (colsum[j] > r)
+			r = colsum[j];
+	return r;
+}
+
+// Hager's estimate of ||A^-1||_1 from a few solves with A and A^T, so the
+// condition number costs O(n^2) on top of an existing factorization.
+double invNorm1(int n, const std::function<void(double *x, bool trans)> &solve){
+	std::vector<double> x(n, 1. / n), y(n), z(n);
+	double est = 0;
+	for (int it = 0; it < INVNORM_MAX_ITERATIONS; it++){
+		y = x;
+		solve(y.data(), false);
+		double norm = 0;
+		for (int i = 0; i < n; i++){
+			norm += abs(y[i]);
+			z[i] = y[i] >= 0 ? 1 : -1;
+		}
+		if (it > 0 && norm <= est)
+			break;
+		est = norm;
+		solve(z.data(), true);
+		int jmax = 0;
+		double ztx = 0;
+		for (int i = 0; i < n; i++){
+			if (abs(z[i]) > abs(z[jmax]))
+				jmax = i;
+			ztx += z[i] * x[i];
+		}
+		if (abs(z[jmax]) <= ztx)
+			break;
+		std::fill(x.begin(), x.end(), 0.);
+		x[jmax] = 1;
+	}
+	return est;
+}
+
+// M = M P for the reflector P = I - v v^T / h acting on entries k + 1.. n - 1,
+// as a sweep over whole rows split between threads.
+static void reflectRows(double *m, int n, const double *v, int k, double h){
+	parallelFor(0, n, PARALLEL_GRAIN_ROWS, [&](int from, int to){
+		for (int i = from; i < to; i++){
+			double *row = m + i * n, s = 0;
+			for (int j = k + 1; j < n; j++)
+				s += row[j] * v[j];
+			s /= h;
+			for (int j = k + 1; j < n; j++)
+				row[j] -= s * v[j];
+		}
+	});
+}
+
+// Householder reduction to upper Hessenberg form, H = Q^T A Q, in place. If q
+// is not NULL it receives Q. Every reflector is applied as a sweep over whole
+// rows, split between threads for large matrices.
+void hessenberg(double *a, int n, double *q){
+	auto A = [a, n](int i, int j) -> double & { return a[i * n + j]; };
+	std::vector<double> v(n), w(n);
+	if (q)
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++)
+				q[i * n + j] = i == j;
+	for (int k = 0; k < n - 2; k++){
+		double scale = 0, h = 0;
+		for (int i = k + 1; i < n; i++)
+			scale += abs(A(i, k));
+		if (scale == 0)
+			continue;
+		for (int i = k + 1; i < n; i++){
+			v[i] = A(i, k) / scale;
+			h += v[i] * v[i];
+		}
+		double g = v[k + 1] >= 0 ? -sqrt(h) : sqrt(h);
+		h -= v[k + 1] * g;
+		v[k + 1] -= g;
+		// P = I - v v^T / h, applied as A = P A P
+		parallelFor(k, n, PARALLEL_GRAIN_ROWS, [&](int from, int to){
+			for (int j = from; j < to; j++)
+				w[j] = 0;
+			for (int i = k + 1; i < n; i++)
+				for (int j = from; j < to; j++)
+					w[j] += v[i] * A(i, j);
+			for (int i = k + 1; i < n; i++){
+				double s = v[i] / h;
+				for (int j = from; j < to; j++)
+					A(i, j) -= s * w[j];
+			}
+		});
+		reflectRows(a, n, v.data(), k, h);
+		if (q)
+			reflectRows(q, n, v.data(), k, h);
+		A(k + 1, k) = scale * g;
+		for (int i = k + 2; i < n; i++)
+			A(i, k) = 0;
+	}
+}
+
+struct cplx{
+	double re, im;
+};
+
+cplx cdiv(cplx a, cplx b){
+	if (abs(b.re) >= abs(b.im)){
+		double r = b.im / b.re, d = b.re + r * b.im;
+		return {(a.re + r * a.im) / d, (a.im - r * a.re) / d};
+	}
+	double r = b.re / b.im, d = b.im + r * b.re;
+	return {(a.re * r + a.im) / d, (a.im * r - a.re) / d};
+}
+
+double cabs(cplx a){
+	return abs(a.re) + abs(a.im);
+}
+
+// Eigenvector of the upper Hessenberg matrix h for the eigenvalue (lr, li)
+// by inverse iteration. H - lambda I is factored into the n x n workspace m
+// with pivoting between adjacent rows only, so each eigenvector costs O(n^2).
+void hessenbergVector(const double *h, int n, double lr, double li, std::vector<cplx> &m, double *yr, double *yi){
+	std::vector<cplx> y(n, {1., 0.}), l(n);
+	std::vector<bool> swapped(n, false);
+	double norm = 0;
+	for (int i = 0; i < n; i++)
+		for (int j = max(i - 1, 0); j < n; j++){
+			m[i * n + j] = {h[i * n + j] - (i == j ? lr : 0), i == j ? -li : 0};
+			norm += abs(h[i * n + j]);
+		}
+	double tiny = EPSILON * (norm > 0 ? norm : 1);
+	auto M = [&m, n](int i, int j) -> cplx & { return m[i * n + j]; };
+	for (int k = 0; k < n - 1; k++){
+		if (cabs(M(k + 1, k)) > cabs(M(k, k))){
+			std::swap_ranges(m.begin() + k * n + k, m.begin() + k * n + n, m.begin() + (k + 1) * n + k);
+			swapped[k] = true;
+		}
+		if (cabs(M(k, k)) == 0)
+			M(k, k) = {tiny, 0};
+		l[k] = cdiv(M(k + 1, k), M(k, k));
+		for (int j = k + 1; j < n; j++){
+			cplx u = M(k, j);
+			M(k + 1, j).re -= l[k].re * u.re - l[k].im * u.im;
+			M(k + 1, j).im -= l[k].re * u.im + l[k].im * u.re;
+		}
+		M(k + 1, k) = {0, 0};
+	}
+	if (cabs(M(n - 1, n - 1)) == 0)
+		M(n - 1, n - 1) = {tiny, 0};
+	for (int it = 0; it < INVERSE_ITERATIONS; it++){
+		for (int k = 0; k < n - 1; k++){
+			if (swapped[k])
+				std::swap(y[k], y[k + 1]);
+			y[k + 1].re -= l[k].re * y[k].re - l[k].im * y[k].im;
+			y[k + 1].im -= l[k].re * y[k].im + l[k].im * y[k].re;
+		}
+		for (int i = n - 1; i >= 0; i--){
+			cplx s = y[i];
+			for (int j = i + 1; j < n; j++){
+				s.re -= M(i, j).re * y[j].re - M(i, j).im * y[j].im;
+				s.im -= M(i, j).re * y[j].im + M(i, j).im * y[j].re;
+			}
+			y[i] = cdiv(s, M(i, i));
+		}
+		double ymax = 0;
+		for (int i = 0; i < n; i++)
+			if (cabs(y[i]) > ymax)
+				ymax = cabs(y[i]);
+		for (int i = 0; i < n; i++)
+			y[i] = {y[i].re / ymax, y[i].im / ymax};
+	}
+	for (int i = 0; i < n; i++){
+		yr[i] = y[i].re;
+		yi[i] = y[i].im;
+	}
+}
+
+// Scales x + i y to unit length and turns its largest component real and
+// positive, so that results do not depend on the starting vector.
+void normalizeVector(double *x, double *y, int n){
+	int imax = 0;
+	double norm = 0;
+	for (int i = 0; i < n; i++){
+		double m = x[i] * x[i] + (y ? y[i] * y[i] : 0);
+		norm += m;
+		if (m > x[imax] * x[imax] + (y ? y[imax] * y[imax] : 0))
+			imax = i;
+	}
+	double cr = x[imax], ci = y ? -y[imax] : 0, cm = sqrt(cr * cr + ci * ci);
+	cr /= cm * sqrt(norm);
+	ci /= cm * sqrt(norm);
+	for (int i = 0; i < n; i++){
+		double re = x[i] * cr - (y ? y[i] * ci : 0);
+		if (y)
+			y[i] = x[i] * ci + y[i] * cr;
+		x[i] = re;
+	}
+}
+
+// Eigenvalues of a general real matrix: balancing, Householder reduction to
+// Hessenberg form and shifted QR. Conjugate pairs are sorted as units by real
+// part and modulus of the imaginary part, the one with positive imaginary
+// part first. If v is not NULL it receives the eigenvectors as columns; a
+// complex pair j, j + 1 stores the real and imaginary parts of the vector of
+// eigenvalue j in columns j and j + 1.
+bool eigenGeneral(const double *a, int n, double *wr, double *wi, double *v){
+	std::vector<double> h(a, a + n * n), d(n), q(v ? n * n : 0), t;
+	balance(h.data(), n, d.data());
+	hessenberg(h.data(), n, v ? q.data() : NULL);
+	t = h;
+	std::vector<double> er(n), ei(n);
+	if (!schurEigenvalues(t.data(), n, er.data(), ei.data()))
+		return false;
+	// a complex pair is stored next to each other, keep one index per pair
+	std::vector<int> order;
+	for (int i = 0; i < n; i++){
+		order.push_back(i);
+		if (ei[i] != 0)
+			i++;
+	}
+	std::sort(order.begin(), order.end(), [&](int x, int y){
+		if (er[x] != er[y])
+			return er[x] < er[y];
+		return abs(ei[x]) < abs(ei[y]);
+	});
+	int j = 0;
+	for (int k : order){
+		wr[j] = er[k];
+		wi[j++] = abs(ei[k]);
+		if (ei[k] != 0){
+			wr[j] = er[k];
+			wi[j++] = -abs(ei[k]);
+		}
+	}
+	if (!v)
+		return true;
+	// Y holds the vectors of H in the output layout, V = D Q Y
+	std::vector<double> y(n * n, 0.), yr(n), yi(n);
+	std::vector<cplx> work(n * n);
+	for (j = 0; j < n; j++){
+		hessenbergVector(h.data(), n, wr[j], wi[j], work, yr.data(), yi.data());
+		for (int i = 0; i < n; i++){
+			y[i * n + j] = yr[i];
+			if (wi[j] != 0)
+				y[i * n + j + 1] = yi[i];
+		}
+		if (wi[j] != 0)
+			j++;
+	}
+	parallelFor(0, n, PARALLEL_GRAIN_ROWS, [&](int from, int to){
+		for (int i = from; i < to; i++){
+			double *vi = v + i * n;
+			std::fill(vi, vi + n, 0.);
+			for (int k = 0; k < n; k++){
+				double qik = d[i] * q[i * n + k];
+				const double *yk = y.data() + k * n;
+				for (int c = 0; c < n; c++)
+					vi[c] += qik * yk[c];
+			}
+		}
+	});
+	std::vector<double> xr(n), xi(n);
+	for (j = 0; j < n; j++){
+		bool complex = wi[j] != 0;
+		for (int i = 0; i < n; i++){
+			xr[i] = v[i * n + j];
+			if (complex)
+				xi[i] = v[i * n + j + 1];
+		}
+		normalizeVector(xr.data(), complex ? xi.data() : NULL, n);
+		for (int i = 0; i < n; i++){
+			v[i * n + j] = xr[i];
+			if (complex)
+				v[i * n + j + 1] = xi[i];
+		}
+		if (complex)
+			j++;
+	}
+	return true;
+}
+
+// sqrt(a^2 + b^2) without overflow or underflow in the squares.
+static double hypot2(double a, double b){
+	a = abs(a);
+	b = abs(b);
+	if (a < b)
+		std::swap(a, b);
+	return a == 0 ? 0 : a * sqrt(1 + (b / a) * (b / a));
+}
+
+// Householder reduction of a symmetric matrix to tridiagonal form, T = Q^T A Q
+// (Golub and Van Loan, 8.3.1): column k is reflected away below the
+// subdiagonal and the trailing block gets the symmetric rank-2 update
+// A - v w^T - w v^T. T is returned as its diagonal d and subdiagonal e[0..n-2];
+// if q is not NULL it receives Q. The matrix is destroyed.
+void tridiagonalize(double *a, int n, double *d, double *e, double *q){
+	auto A = [a, n](int i, int j) -> double & { return a[i * n + j]; };
+	std::vector<double> v(n), w(n);
+	if (q)
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++)
+				q[i * n + j] = i == j;
+	for (int k = 0; k < n - 2; k++){
+		double scale = 0, h = 0;
+		for (int i = k + 1; i < n; i++)
+			scale += abs(A(i, k));
+		if (scale == 0)
+			continue;
+		for (int i = k + 1; i < n; i++){
+			v[i] = A(i, k) / scale;
+			h += v[i] * v[i];
+		}
+		double g = v[k + 1] >= 0 ? -sqrt(h) : sqrt(h);
+		h -= v[k + 1] * g;
+		v[k + 1] -= g;
+		// P = I - v v^T / h; p = A v / h and w = p - (v^T p / 2h) v
+		parallelFor(k + 1, n, PARALLEL_GRAIN_ROWS, [&](int from, int to){
+			for (int i = from; i < to; i++){
+				double s = 0;
+				for (int j = k + 1; j < n; j++)
+					s += A(i, j) * v[j];
+				w[i] = s / h;
+			}
+		});
+		double K = 0;
+		for (int i = k + 1; i < n; i++)
+			K += v[i] * w[i];
+		K /= 2 * h;
+		for (int i = k + 1; i < n; i++)
+			w[i] -= K * v[i];
+		parallelFor(k + 1, n, PARALLEL_GRAIN_ROWS, [&](int from, int to){
+			for (int i = from; i < to; i++)
+				for (int j = k + 1; j < n; j++)
+					A(i, j) -= v[i] * w[j] + w[i] * v[j];
+		});
+		if (q)
+			reflectRows(q, n, v.data(), k, h);
+		A(k + 1, k) = A(k, k + 1) = scale * g;
+		for (int i = k + 2; i < n; i++)
+			A(i, k) = A(k, i) = 0;
+	}
+	for (int i = 0; i < n; i++){
+		d[i] = A(i, i);
+		if (i + 1 < n)
+			e[i] = A(i + 1, i);
+	}
+}
+
+// Implicit symmetric QR steps with the Wilkinson shift on the tridiagonal
+// matrix (d, e) (Golub and Van Loan, 8.3.2). Every step chases the bulge
+// down the active block with Givens rotations; qt holds the transformation
+// transposed, so that each rotation combines two contiguous rows, and its
+// rows end up being the eigenvectors.
+bool symmetricQR(double *d, double *e, int n, double *qt){
+	int its = 0;
+	for (int hi = n - 1; hi > 0;){
+		if (abs(e[hi - 1]) <= EPSILON * (abs(d[hi - 1]) + abs(d[hi]))){
+			e[hi - 1] = 0;
+			hi--;
+			its = 0;
+			continue;
+		}
+		if (its++ == SYMMETRIC_QR_MAX_ITERATIONS)
+			return false;
+		int lo = hi - 1;
+		while (lo > 0 && abs(e[lo - 1]) > EPSILON * (abs(d[lo - 1]) + abs(d[lo])))
+			lo--;
+		// the eigenvalue of the trailing 2 x 2 block closer to its last entry
+		double delta = (d[hi - 1] - d[hi]) / 2, b = e[hi - 1];
+		double mu = d[hi] - b * b / (delta + (delta >= 0 ? 1 : -1) * hypot2(delta, b));
+		double x = d[lo] - mu, z = e[lo], bulge = 0;
+		for (int k = lo; k < hi; k++){
+			// R = [[c, s], [-s, c]] on rows and columns k, k + 1 with
+			// R (x, z) = (r, 0)
+			double r = hypot2(x, z), c = r != 0 ? x / r : 1, s = r != 0 ? z / r : 0;
+			if (k > lo)
+				e[k - 1] = r;
+			double dk = d[k], dk1 = d[k + 1], ek = e[k];
+			d[k] = c * c * dk + 2 * c * s * ek + s * s * dk1;
+			d[k + 1] = s * s * dk - 2 * c * s * ek + c * c * dk1;
+			e[k] = c * s * (dk1 - dk) + (c * c - s * s) * ek;
+			if (k + 1 < hi){
+				bulge = s * e[k + 1];
+				e[k + 1] *= c;
+			}
+			x = e[k];
+			z = bulge;
+			if (qt){
+				double *qk = qt + k * n, *qk1 = qt + (k + 1) * n;
+				for (int j = 0; j < n; j++){
+					double t = qk[j];
+					qk[j] = c * t + s * qk1[j];
+					qk1[j] = c * qk1[j] - s * t;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// Eigenvalues of a symmetric matrix in ascending order by tridiagonal
+// reduction and implicit QR; if v is not NULL it receives the orthonormal
+// eigenvectors as columns.
+bool eigenSymmetric(const double *a, int n, double *w, double *v){
+	std::vector<double> z(a, a + n * n), e(n), q(v ? n * n : 0), qt(v ? n * n : 0);
+	tridiagonalize(z.data(), n, w, e.data(), v ? q.data() : NULL);
+	if (v)
+		transpose(q.data(), n, qt.data(), n, n);
+	if (!symmetricQR(w, e.data(), n, v ? qt.data() : NULL))
+		return false;
+	std::vector<int> order(n);
+	for (int i = 0; i < n; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [w](int x, int y){ return w[x] < w[y]; });
+	std::vector<double> sorted(n);
+	for (int j = 0; j < n; j++)
+		sorted[j] = w[order[j]];
+	std::copy(sorted.begin(), sorted.end(), w);
+	if (v)
+		for (int j = 0; j < n; j++){
+			double *x = qt.data() + order[j] * n;
+			normalizeVector(x, NULL, n);
+			for (int i = 0; i < n; i++)
+				v[i * n + j] = x[i];
+		}
+	return true;
+}
+
+// C = A B for an n x m A and an m x p B, row by row in i-k-j order so that
+// the inner loop streams rows of B and C. When the result is known to be
+// symmetric only its upper triangle is computed and then mirrored.
+template <typename T>
+void matmul(const T *a, const T *b, T *c, int n, int m, int p, bool symmetric){
+	parallelFor(0, n, PARALLEL_GRAIN_ROWS, [&](int from, int to){
+		for (int i = from; i < to; i++){
+			T *ci = c + (size_t)i * p;
+			int j0 = symmetric ? i : 0;
+			std::fill(ci + j0, ci + p, T(0));
+			for (int k = 0; k < m; k++){
+				T aik = a[(size_t)i * m + k];
+				if (aik == 0)
+					continue;
+				const T *bk = b + (size_t)k * p;
+				for (int j = j0; j < p; j++)
+					ci[j] += aik * bk[j];
+			}
+		}
+	});
+	if (symmetric)
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < i; j++)
+				c[(size_t)i * p + j] = c[(size_t)j * p + i];
+}
+
+// C = A op B element by element for n x m operands with row strides lda and
+// ldb (slices) into a packed C; op is one of + - *.
+template <typename T>
+void elementwise(const T *a, int lda, const T *b, int ldb, T *c, int n, int m, char opcode){
+	for (int i = 0; i < n; i++){
+		const T *ai = a + (size_t)i * lda, *bi = b + (size_t)i * ldb;
+		T *ci = c + (size_t)i * m;
+		if (opcode == '+')
+			for (int j = 0; j < m; j++)
+				ci[j] = ai[j] + bi[j];
+		else if (opcode == '-')
+			for (int j = 0; j < m; j++)
+				ci[j] = ai[j] - bi[j];
+		else
+			for (int j = 0; j < m; j++)
+				ci[j] = ai[j] * bi[j];
+	}
+}
+
+// C = A * s or A / s.
+template <typename T>
+void scale(const T *a, int lda, T s, T *c, int n, int m, char opcode){
+	for (int i = 0; i < n; i++){
+		const T *ai = a + (size_t)i * lda;
+		T *ci = c + (size_t)i * m;
+		if (opcode == '*')
+			for (int j = 0; j < m; j++)
+				ci[j] = ai[j] * s;
+		else
+			for (int j = 0; j < m; j++)
+				ci[j] = ai[j] / s;
+	}
+}
+
+// C = A^T for an n x m A, in TRANSPOSE_BLOCK squares so that the columns
+// written stay in cache.
+template <typename T>
+void transpose(const T *a, int lda, T *c, int n, int m){
+	for (int i0 = 0; i0 < n; i0 += TRANSPOSE_BLOCK)
+		for (int j0 = 0; j0 < m; j0 += TRANSPOSE_BLOCK)
+			for (int i = i0; i < n && i < i0 + TRANSPOSE_BLOCK; i++)
+				for (int j = j0; j < m && j < j0 + TRANSPOSE_BLOCK; j++)
+					c[(size_t)j * n + i] = a[(size_t)i * lda + j];
+}
+
+template void matmul<double>(const double *, const double *, double *, int, int, int, bool);
+template void matmul<float>(const float *, const float *, float *, int, int, int, bool);
+template void elementwise<double>(const double *, int, const double *, int, double *, int, int, char);
+template void elementwise<float>(const float *, int, const float *, int, float *, int, int, char);
+template void scale<double>(const double *, int, double, double *, int, int, char);
+template void scale<float>(const float *, int, float, float *, int, int, char);
+template void transpose<double>(const double *, int, double *, int, int);
+template void transpose<float>(const float *, int, float *, int, int);
+
+// Solves T X = B (or T^T X = B) in place for a triangular T by substitution,
+// O(n^2) per right-hand side. Returns false on a zero diagonal entry.
+bool triangularSolve(const double *t, int n, bool upper, bool trans, double *b, int nrhs){
+	auto T = [t, n, trans](int i, int k){ return trans ? t[k * n + i] : t[i * n + k]; };
+	bool lower = upper == trans;
+	for (int step = 0; step < n; step++){
+		int i = lower ? step : n - 1 - step;
+		double *bi = b + i * nrhs;
+		int from = lower ? 0 : i + 1, to = lower ? i : n;
+		for (int k = from; k < to; k++){
+			double tik = T(i, k);
+			if (tik == 0)
+				continue;
+			for (int c = 0; c < nrhs; c++)
+				bi[c] -= tik * b[k * nrhs + c];
+		}
+		if (T(i, i) == 0)
+			return false;
+		for (int c = 0; c < nrhs; c++)
+			bi[c] /= T(i, i);
+	}
+	return true;
+}
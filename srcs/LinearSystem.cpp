@@ -0,0 +1,232 @@
+#include "LinearSystem.hpp"
+#include <set>
+#include <sstream>
+#include "Linalg.hpp"
+#include "Utils.hpp"
+
+#define SYSTEM_TOLERANCE 1e-12
+#define SYSTEM_PIVOT_THRESHOLD 0.1
+#define SYSTEM_SINGULAR_RCOND 1e-15
+#define SYSTEM_RCOND_WARNING 1e-10
+#define SPARSE_MIN_UNKNOWNS 64
+#define SPARSE_DENSITY 0.1
+
+LinearSystem::LinearSystem(const std::vector<const exprnode *> &equations){
+	for (const exprnode *eq : equations)
+		if (!readEquation(eq))
+			return;
+	_solved = true;
+	size_t n = names.size(), nonzeros = 0;
+	for (const Row &row : rows)
+		nonzeros += row.size();
+	bool sparse = n >= SPARSE_MIN_UNKNOWNS && nonzeros <= SPARSE_DENSITY * n * n;
+	if (n == 0 || rows.size() != n || sparse || !solveDense())
+		solveSparse();
+}
+
+bool LinearSystem::getSolved() const{
+	return _solved;
+}
+
+std::string LinearSystem::getMsg() const{
+	return _errmsg;
+}
+
+const std::vector<std::string> &LinearSystem::getNotes() const{
+	return notes;
+}
+
+const std::vector<std::pair<std::string, double>> &LinearSystem::getSolution() const{
+	return solution;
+}
+
+// left - right = 0 as a row of coefficients and a right-hand side.
+bool LinearSystem::readEquation(const exprnode *eq){
+	Row row;
+	double constant = 0;
+	complex = false;
+	if (!eq || eq->opcode != '=' || !readTerms(eq->left, 1, row, constant) || !readTerms(eq->right, -1, row, constant)){
+		std::stringstream ss;
+		ss << "Equation " << rows.size() + 1 << (complex ? " has complex coefficients" : " is not linear") << ", I can't solve.";
+		_errmsg = ss.str();
+		return false;
+	}
+	for (Row::iterator it = row.begin(); it != row.end();)
+		it = it->second == 0 ? row.erase(it) : ++it;
+	rows.push_back(row);
+	rhs.push_back(-constant);
+	return true;
+}
+
+// A real number. Complex ones are noted: the system may well be linear, but
+// it is solved over the reals only.
+bool LinearSystem::realConstant(const exprnode *node){
+	if (node->opcode != 'c')
+		return false;
+	complex = complex || (node->value.isComplex() && !node->value.isReal());
+	return node->value.isReal();
+}
+
+// Adds scale times the terms of root; constants are folded by evaluation,
+// so a product or quotient is linear only with a number on one side.
+bool LinearSystem::readTerms(const exprnode *root, double scale, Row &row, double &constant){
+	switch (root->opcode){
+	case 'c':
+		if (!realConstant(root))
+			return false;
+		constant += scale * root->value.Re();
+		return true;
+	case 'v':{
+		auto it = index.find(root->varname);
+		if (it == index.end()){
+			it = index.insert({root->varname, (int)names.size()}).first;
+			names.push_back(root->varname);
+		}
+		row[it->second] += scale;
+		return true;
+	}
+	case '+':
+	case '-':
+		return readTerms(root->left, scale, row, constant)
+			&& readTerms(root->right, root->opcode == '-' ? -scale : scale, row, constant);
+	case '*':
+		if (realConstant(root->left))
+			return readTerms(root->right, scale * root->left->value.Re(), row, constant);
+		if (realConstant(root->right))
+			return readTerms(root->left, scale * root->right->value.Re(), row, constant);
+		return false;
+	case '/':
+		if (realConstant(root->right) && root->right->value.Re() != 0)
+			return readTerms(root->left, scale / root->right->value.Re(), row, constant);
+		return false;
+	}
+	return false;
+}
+
+// Square and mostly nonzero: the blocked LU with partial pivoting. Fails
+// on singular or numerically singular matrices, which the elimination
+// below then sorts out.
+bool LinearSystem::solveDense(){
+	int n = names.size();
+	std::vector<double> a((size_t)n * n), f, x = rhs;
+	for (int i = 0; i < n; i++)
+		for (const auto &e : rows[i])
+			a[(size_t)i * n + e.first] = e.second;
+	f = a;
+	std::vector<int> perm(n);
+	if (!lu(f.data(), n, perm.data()))
+		return false;
+	double rcond = 1 / (norm1(a.data(), n) * invNorm1(n, [&](double *b, bool trans){
+		if (trans)
+			luSolveTrans(f.data(), n, perm.data(), b);
+		else
+			luSolve(f.data(), n, perm.data(), b, 1);
+	}));
+	if (!(rcond >= SYSTEM_SINGULAR_RCOND))
+		return false;
+	if (rcond < SYSTEM_RCOND_WARNING){
+		std::stringstream ss;
+		ss << "Warning: system is near singular, condition number estimate " << 1 / rcond;
+		notes.push_back(ss.str());
+	}
+	luSolve(f.data(), n, perm.data(), x.data(), 1);
+	_errmsg = "The solution is:";
+	for (int j = 0; j < n; j++)
+		solution.push_back({names[j], x[j]});
+	return true;
+}
+
+// Gaussian elimination on sparse rows. Each step takes the column in the
+// fewest remaining rows and, among the rows whose entry there is within
+// SYSTEM_PIVOT_THRESHOLD of the largest, the one with the fewest nonzeros,
+// which keeps fill-in low. Columns left without a pivot are free; rows left
+// without one read 0 = rhs and are redundant or contradictory, which is
+// all there is to equations without variables.
+void LinearSystem::solveSparse(){
+	int m = rows.size(), n = names.size();
+	double big = 0;
+	for (int i = 0; i < m; i++){
+		big = std::max(big, abs(rhs[i]));
+		for (const auto &e : rows[i])
+			big = std::max(big, abs(e.second));
+	}
+	double tol = SYSTEM_TOLERANCE * big;
+	std::vector<std::set<int>> cols(n);
+	for (int i = 0; i < m; i++)
+		for (const auto &e : rows[i])
+			cols[e.first].insert(i);
+	std::vector<int> pivot(n, -1), order;
+	std::vector<char> done(n, 0), used(m, 0);
+	for (int step = 0; step < n; step++){
+		int col = -1;
+		for (int j = 0; j < n; j++)
+			if (!done[j] && (col < 0 || cols[j].size() < cols[col].size()))
+				col = j;
+		done[col] = 1;
+		order.push_back(col);
+		double largest = 0;
+		for (int i : cols[col])
+			largest = std::max(largest, abs(rows[i][col]));
+		if (largest <= tol){
+			for (int i : cols[col])
+				rows[i].erase(col);
+			cols[col].clear();
+			continue;
+		}
+		int p = -1;
+		for (int i : cols[col])
+			if (abs(rows[i][col]) >= SYSTEM_PIVOT_THRESHOLD * largest && (p < 0 || rows[i].size() < rows[p].size()))
+				p = i;
+		pivot[col] = p;
+		used[p] = 1;
+		for (const auto &e : rows[p])
+			cols[e.first].erase(p);
+		std::vector<int> targets(cols[col].begin(), cols[col].end());
+		for (int i : targets){
+			double factor = rows[i][col] / rows[p][col];
+			rows[i].erase(col);
+			for (const auto &e : rows[p]){
+				if (e.first == col)
+					continue;
+				auto it = rows[i].insert({e.first, 0.}).first;
+				cols[e.first].insert(i);
+				it->second -= factor * e.second;
+				if (abs(it->second) <= tol){
+					rows[i].erase(it);
+					cols[e.first].erase(i);
+				}
+			}
+			rhs[i] -= factor * rhs[p];
+		}
+		cols[col].clear();
+	}
+	for (int i = 0; i < m; i++)
+		if (!used[i] && abs(rhs[i]) > tol){
+			_errmsg = "There is no solution.";
+			return;
+		}
+	if (n == 0){
+		_errmsg = "Every equation holds.";
+		return;
+	}
+	std::stringstream freevars;
+	for (int j = 0; j < n; j++)
+		if (pivot[j] < 0)
+			freevars << (freevars.str().empty() ? "" : ", ") << names[j];
+	if (!freevars.str().empty()){
+		_errmsg = "There are infinitely many solutions, free variables: " + freevars.str() + ".";
+		return;
+	}
+	std::vector<double> x(n);
+	for (int k = n - 1; k >= 0; k--){
+		int col = order[k], p = pivot[col];
+		double s = rhs[p];
+		for (const auto &e : rows[p])
+			if (e.first != col)
+				s -= e.second * x[e.first];
+		x[col] = s / rows[p][col];
+	}
+	_errmsg = "The solution is:";
+	for (int j = 0; j < n; j++)
+		solution.push_back({names[j], x[j]});
+}
@@ -0,0 +1,39 @@
+#include "MatBuffer.hpp"
+
+MatBuffer::MatBuffer(size_t size) : v(size, 0.){
+	p = v.data();
+	n = size;
+}
+
+MatBuffer::MatBuffer(const double *from, size_t size) : v(from, from + size){
+	p = v.data();
+	n = size;
+}
+
+MatBuffer::MatBuffer(std::vector<double> &&values) : v(std::move(values)){
+	p = v.data();
+	n = v.size();
+}
+
+MatBuffer::MatBuffer() : p(NULL), n(0) {}
+
+MatBuffer::~MatBuffer() {}
+
+double *MatBuffer::data() const{
+	return p;
+}
+
+size_t MatBuffer::size() const{
+	return n;
+}
+
+// Grows in place; the vector's spare capacity keeps element by element
+// growth of matrix literals amortized. Memory not owned by the vector is
+// copied into it first.
+void MatBuffer::resize(size_t size){
+	if (p != v.data())
+		v.assign(p, p + n);
+	v.resize(size, 0.);
+	p = v.data();
+	n = size;
+}
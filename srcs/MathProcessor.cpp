@@ -1,6 +1,12 @@
 #include "MathProcessor.hpp"
 #include "PolySolver.hpp"
+#include "NewtonSolver.hpp"
+#include "LinearSystem.hpp"
+#include "Tabulate.hpp"
 #include "Utils.hpp"
+#include <iomanip>
+#include <fstream>
+#include <chrono>
 
 MathProcessor::MathProcessor(){}
 
@@ -13,9 +19,16 @@ MathProcessor &MathProcessor::operator=(const MathProcessor &other)
 {
 	if (this == &other)
 		return (*this);
+	for (auto i : defs)
+		delete i.second;
 	defs.clear();
 	for(auto i:other.defs)
 		defs[i.first] = new Expression(*i.second);
+	bracket[0] = other.bracket[0];
+	bracket[1] = other.bracket[1];
+	tolerance = other.tolerance;
+	explain = other.explain;
+	memory = other.memory;
 	return (*this);
 }
 
@@ -24,21 +37,269 @@ MathProcessor::~MathProcessor(){
 		delete i.second;
 }
 
+void collectBuffers(const exprnode *root, std::map<const void *, size_t> &buffers){
+	if (!root)
+		return;
+	if (root->opcode == 'c' && root->value.isMatrix() && !root->value.isTiled())
+		buffers[root->value.Buffer()] = root->value.BufferBytes();
+	collectBuffers(root->left, buffers);
+	collectBuffers(root->right, buffers);
+}
+
+std::string formatBytes(size_t n){
+	const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+	double size = n;
+	int unit = 0;
+	while (size >= 1024 && unit < 4){
+		size /= 1024;
+		unit++;
+	}
+	std::stringstream ss;
+	ss << std::setprecision(3) << size << " " << units[unit];
+	return ss.str();
+}
+
+// ls: every definition with the matrix data it holds. Definitions built from
+// one another share buffers, so each buffer is counted once in the total
+// and named after the first definition holding it.
+std::string MathProcessor::processList() const{
+	std::stringstream ss;
+	std::map<const void *, std::string> owners;
+	size_t total = 0;
+	for (auto i : defs){
+		ss << "  " << i.first << " : " << i.second->Print();
+		std::map<const void *, size_t> buffers;
+		collectBuffers(i.second->getRoot(), buffers);
+		size_t bytes = 0;
+		std::set<std::string> shared;
+		for (auto b : buffers){
+			bytes += b.second;
+			if (owners.find(b.first) != owners.end())
+				shared.insert(owners[b.first]);
+			else{
+				owners[b.first] = i.first;
+				total += b.second;
+			}
+		}
+		if (bytes > 0){
+			ss << "  (" << formatBytes(bytes);
+			for (auto name = shared.begin(); name != shared.end(); name++)
+				ss << (name == shared.begin() ? ", shared with " : ", ") << *name;
+			ss << ")";
+		}
+		ss << std::endl;
+	}
+	ss << "  " << defs.size() << " defines total";
+	if (total > 0)
+		ss << ", " << formatBytes(total) << " of matrix data";
+	ss << "." << std::endl;
+	return ss.str();
+}
+
 bool MathProcessor::isError() const{
 	return error;
 }
 
+// set [bracket <lo> <hi> | tolerance <t> | explain on|off | memory <size>]
+std::string MathProcessor::processSet(const std::string &command){
+	std::stringstream in(command), ss;
+	std::string cmd, name;
+	in >> cmd >> name;
+	if (name == "bracket"){
+		double lo, hi;
+		if (!(in >> lo >> hi) || !(lo < hi) || !in.eof()){
+			error = true;
+			return "  Incorrect bracket!\n";
+		}
+		bracket[0] = lo;
+		bracket[1] = hi;
+	}else if (name == "tolerance"){
+		double t;
+		if (!(in >> t) || !(t > 0) || !in.eof()){
+			error = true;
+			return "  Incorrect tolerance!\n";
+		}
+		tolerance = t;
+	}else if (name == "explain"){
+		std::string value;
+		if (!(in >> value) || (value != "on" && value != "off") || !in.eof()){
+			error = true;
+			return "  Incorrect explain mode!\n";
+		}
+		explain = value == "on";
+	}else if (name == "memory"){
+		double n;
+		std::string unit;
+		if (!(in >> n) || !(n >= 1)){
+			error = true;
+			return "  Incorrect memory limit!\n";
+		}
+		in >> unit;
+		unit = lower(unit);
+		if (unit == "k" || unit == "kb")
+			n *= 1024;
+		else if (unit == "m" || unit == "mb")
+			n *= 1024 * 1024;
+		else if (unit == "g" || unit == "gb")
+			n *= 1024 * 1024 * 1024;
+		else if (!unit.empty() && unit != "b"){
+			error = true;
+			return "  Incorrect memory limit!\n";
+		}
+		if (!in.eof() || n < TILE * TILE * sizeof(double)){
+			error = true;
+			return "  Incorrect memory limit!\n";
+		}
+		memory = n;
+	}else if (!name.empty()){
+		error = true;
+		return "  Unknown setting!\n";
+	}
+	ss << "  bracket : [" << fixedout(bracket[0]) << ", " << fixedout(bracket[1]) << "]" << std::endl;
+	ss << "  tolerance : " << tolerance << std::endl;
+	ss << "  explain : " << (explain ? "on" : "off") << std::endl;
+	ss << "  memory : " << formatBytes(memory) << std::endl;
+	return ss.str();
+}
+
+// table f from <a> to <b> step <h> [> file] and tabulate(f, a, b, n) [> file]:
+// f at the points of the grid as "x,f(x)" rows, on stdout or into file. f
+// is compiled once; the answer is the throughput.
+std::string MathProcessor::processTable(const std::string &command){
+	std::string spec = command, path, name, word[4];
+	size_t redirect = spec.find('>');
+	if (redirect != std::string::npos){
+		path = spec.substr(redirect + 1);
+		spec.erase(redirect);
+		trim(path);
+		if (path.size() >= 2 && path.front() == '"' && path.back() == '"')
+			path = path.substr(1, path.size() - 2);
+	}
+	double from, to, step, n = 0;
+	bool ok;
+	if (spec.find("tabulate") == 0){
+		for (char &c : spec)
+			if (c == '(' || c == ')' || c == ',')
+				c = ' ';
+		std::stringstream in(spec);
+		ok = in >> word[0] >> name >> from >> to >> n && (in >> std::ws).eof() && n >= 1 && n == (long long)n;
+		step = n > 1 ? (to - from) / (n - 1) : 0;
+	}else{
+		std::stringstream in(spec);
+		ok = in >> word[0] >> name >> word[1] >> from >> word[2] >> to >> word[3] >> step && (in >> std::ws).eof()
+			&& word[1] == "from" && word[2] == "to" && word[3] == "step" && step > 0 && from <= to;
+		// the last point may fall a rounding error past to
+		if (ok)
+			n = (long long)((to - from) / step * (1 + 1e-12)) + 1;
+	}
+	if (!ok || (redirect != std::string::npos && path.empty())){
+		error = true;
+		return "  Incorrect table!\n";
+	}
+	auto def = defs.find(lower(name));
+	ExprProgram f;
+	if (def == defs.end() || def->second->getRoot()->left->opcode != 'f'
+		|| !f.compile(def->second->getRoot()->right, def->second->getRoot()->left->left->varname)){
+		error = true;
+		return "  Function can't be tabulated!\n";
+	}
+	std::ofstream file;
+	if (!path.empty())
+		file.open(path, std::ios::binary | std::ios::trunc);
+	std::ostream &out = path.empty() ? std::cout : file;
+	auto start = std::chrono::steady_clock::now();
+	if ((!path.empty() && !file) || !tabulate(f, from, step, (long long)n, out)){
+		error = true;
+		return "  Can't write table!\n";
+	}
+	std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+	std::stringstream ss;
+	ss << "  " << (long long)n << " points";
+	if (t.count() > 0)
+		ss << ", " << std::setprecision(3) << n / t.count() << " points/s";
+	ss << std::endl;
+	return ss.str();
+}
+
+// Splits at the ';' outside brackets, which inside them separate matrix rows.
+static std::vector<std::string> splitEquations(const std::string &command){
+	std::vector<std::string> parts(1);
+	int depth = 0;
+	for (char c : command){
+		depth += c == '[' || c == '(' ? 1 : c == ']' || c == ')' ? -1 : 0;
+		if (c == ';' && depth == 0)
+			parts.push_back("");
+		else
+			parts.back() += c;
+	}
+	return parts;
+}
+
+// Equations separated by ';', each evaluated with the current definitions
+// and then solved together as a linear system.
+std::string MathProcessor::processSystem(const std::vector<std::string> &parts){
+	std::stringstream ss;
+	std::vector<Expression *> system;
+	std::vector<const exprnode *> equations;
+	try{
+		for (const std::string &part : parts){
+			system.push_back(new Expression(part));
+			if (system.back()->getRoot()->opcode != '=')
+				throw Expression::IncorrectExpression();
+		}
+	}catch (const std::exception &e){
+		for (Expression *eq : system)
+			delete eq;
+		error = true;
+		return "  Can't read query!\n";
+	}
+	try{
+		for (Expression *eq : system){
+			eq->setExplain(explain);
+			eq->Evaluate(defs);
+			ss << "  " << eq->Print() << std::endl;
+			for (auto note : eq->getNotes())
+				ss << "  " << note << std::endl;
+			equations.push_back(eq->getRoot());
+		}
+	}catch (const std::exception &e){
+		ss << "  " << e.what() << std::endl;
+		error = true;
+	}
+	if (!error){
+		LinearSystem linear(equations);
+		for (auto note : linear.getNotes())
+			ss << "  " << note << std::endl;
+		ss << "  " << linear.getMsg() << std::endl;
+		for (auto x : linear.getSolution())
+			ss << "  " << x.first << " = " << printPolynom({{0, x.second}}, "i") << std::endl;
+	}
+	for (Expression *eq : system)
+		delete eq;
+	return ss.str();
+}
+
+// The command word alone or followed by its arguments; none of the commands
+// take an '=', so lines with one stay assignments and queries of a
+// variable that happens to share the name.
+static bool isCommand(const std::string &command, const std::string &word){
+	return command.find('=') == std::string::npos
+		&& (command == word || command.compare(0, word.size() + 1, word + " ") == 0);
+}
+
 std::string MathProcessor::processCommand(std::string &command){
+	TiledMatrix::MemoryLimit limit(memory);
 	error = false;
 	if (command.empty() || command.front() == '#')
 		return "";
 	std::stringstream ss;
-	if (command == "ls"){
-		for (auto i : defs)
-			ss << "  " << i.first << " : " << i.second->Print() << std::endl;
-		ss << "  " << defs.size() << " defines total." << std::endl;
-		return ss.str();
-	}
+	if (command == "ls")
+		return processList();
+	if (isCommand(command, "set"))
+		return processSet(command);
+	if (isCommand(command, "table") || (command.find('=') == std::string::npos
+										 && (command.find("tabulate(") == 0 || command.find("tabulate (") == 0)))
+		return processTable(command);
 	enum QueryType{
 		define,
 		solve,
@@ -54,6 +315,8 @@ std::string MathProcessor::processCommand(std::string &command){
 			command.pop_back();
 		}
 	}
+	if (qType == solve && splitEquations(command).size() > 1)
+		return processSystem(splitEquations(command));
 	ss << "  ";
 	Expression *_expr = NULL;
 	try{
@@ -75,6 +338,7 @@ std::string MathProcessor::processCommand(std::string &command){
 		return ss.str();
 	}
 	//std::cout << _expr->treePrint() << std::endl;
+	_expr->setExplain(explain);
 	try{
 		if (qType != define)
 			_expr->Evaluate(defs);
@@ -92,6 +356,8 @@ std::string MathProcessor::processCommand(std::string &command){
 	}
 	if (qType == define){
 		ss << _expr->getRoot()->right->Print() << std::endl;
+		for (auto note : _expr->getNotes())
+			ss << "  " << note << std::endl;
 		//std::cout << _expr->treePrint();
 		std::string key = _expr->getRoot()->left->varname;
 		if (defs.find(key) != defs.end())
@@ -100,12 +366,25 @@ std::string MathProcessor::processCommand(std::string &command){
 	}
 	if (qType == calculate){
 		ss << _expr->Print() << std::endl;
+		for (auto note : _expr->getNotes())
+			ss << "  " << note << std::endl;
 		delete _expr;
 	}
 	if (qType == solve){
-		std::string eq = _expr->Print();
-		ss << eq << std::endl;
-		PolySolver solver(eq);
+		ss << _expr->Print() << std::endl;
+		for (auto note : _expr->getNotes())
+			ss << "  " << note << std::endl;
+		PolySolver solver(_expr->getRoot());
+		if (!solver.getSolved() && _expr->getVars().size() == 1){
+			NewtonSolver newton(_expr->getRoot(), *_expr->getVars().begin(), bracket[0], bracket[1], tolerance);
+			if (newton.getSolved()){
+				ss << "  " << newton.getMsg() << std::endl;
+				for (auto x : newton.getRoots())
+					ss << "  " << printPolynom(x, "i") << std::endl;
+				delete _expr;
+				return ss.str();
+			}
+		}
 		ss << "  " << solver.getMsg() << std::endl;
 		for (auto x : solver.getRoots())
 			ss << "  " << printPolynom(x, "i") << std::endl;
@@ -0,0 +1,67 @@
+#include "MatrixChain.hpp"
+#include <sstream>
+
+// best[i][j] is the flop count of the cheapest product of factors i..j, a
+// p x q by q x r product costing 2pqr. Splits are tried right to left so that
+// ties keep the left to right order of the text.
+MatrixChain::MatrixChain(const std::vector<const ExprValue *> &factors) : factors(factors){
+	int k = factors.size();
+	dims.push_back(factors[0]->Rows());
+	for (auto f : factors){
+		if (!f->isMatrix() || f->Rows() != dims.back())
+			throw ExprValue::InvalidOperand();
+		dims.push_back(f->Cols());
+	}
+	best.assign(k, std::vector<double>(k, 0.));
+	split.assign(k, std::vector<int>(k, 0));
+	for (int len = 1; len < k; len++)
+		for (int i = 0; i + len < k; i++){
+			int j = i + len;
+			best[i][j] = -1;
+			for (int s = j - 1; s >= i; s--){
+				double c = best[i][s] + best[s + 1][j] + 2. * dims[i] * dims[s + 1] * dims[j + 1];
+				if (best[i][j] < 0 || c < best[i][j]){
+					best[i][j] = c;
+					split[i][j] = s;
+				}
+			}
+		}
+}
+
+ExprValue MatrixChain::multiply(int i, int j) const{
+	if (i == j)
+		return *factors[i];
+	return multiply(i, split[i][j]) & multiply(split[i][j] + 1, j);
+}
+
+ExprValue MatrixChain::multiply() const{
+	return multiply(0, factors.size() - 1);
+}
+
+double MatrixChain::cost() const{
+	return best[0][factors.size() - 1];
+}
+
+double MatrixChain::naiveCost() const{
+	double c = 0;
+	for (size_t j = 1; j < factors.size(); j++)
+		c += 2. * dims[0] * dims[j] * dims[j + 1];
+	return c;
+}
+
+std::string MatrixChain::plan(int i, int j) const{
+	if (i == j)
+		return "M" + std::to_string(i + 1);
+	return "(" + plan(i, split[i][j]) + " ** " + plan(split[i][j] + 1, j) + ")";
+}
+
+std::string MatrixChain::plan() const{
+	return plan(0, factors.size() - 1);
+}
+
+std::string MatrixChain::shapes() const{
+	std::stringstream ss;
+	for (size_t i = 0; i < factors.size(); i++)
+		ss << (i ? ", " : "") << "M" << i + 1 << " " << dims[i] << "x" << dims[i + 1];
+	return ss.str();
+}
@@ -0,0 +1,203 @@
+#include "MatrixFile.hpp"
+#include "Linalg.hpp"
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Elements of a file mapping, unmapped with the last matrix using them. The
+// mapping is private, so a write only ever reaches this process's pages.
+class MappedBuffer : public MatBuffer
+{
+public:
+	MappedBuffer(void *base, size_t length, size_t offset, size_t size) : base(base), length(length){
+		p = (double *)((char *)base + offset);
+		n = size;
+	}
+	virtual ~MappedBuffer(){
+		munmap(base, length);
+	}
+
+private:
+	void *base;
+	size_t length;
+};
+
+bool isCsv(const std::string &path){
+	return path.size() > 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+}
+
+ExprValue loadCsv(const std::string &path){
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in)
+		throw MatrixFileError();
+	std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	std::vector<double> values;
+	int rows = 0, cols = 0;
+	const char *s = text.c_str();
+	while (*s){
+		int col = 0;
+		while (true){
+			char *end;
+			double x = strtod(s, &end);
+			if (end == s)
+				throw MatrixFileError();
+			values.push_back(x);
+			col++;
+			s = end;
+			while (*s == ' ' || *s == '\t' || *s == '\r')
+				s++;
+			if (*s != ',')
+				break;
+			s++;
+		}
+		if (*s && *s != '\n')
+			throw MatrixFileError();
+		if (rows > 0 && col != cols)
+			throw MatrixFileError();
+		cols = col;
+		rows++;
+		while (*s == '\n' || *s == '\r')
+			s++;
+	}
+	if (rows == 0)
+		throw MatrixFileError();
+	return ExprValue(rows, cols, std::make_shared<MatBuffer>(std::move(values)));
+}
+
+ExprValue loadMatrix(const std::string &path){
+	if (isCsv(path))
+		return loadCsv(path);
+	int fd = open(path.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(MatrixFileHeader)){
+		if (fd >= 0)
+			close(fd);
+		throw MatrixFileError();
+	}
+	size_t length = st.st_size;
+	MatrixFileHeader h;
+	if (pread(fd, &h, sizeof(h), 0) != sizeof(h)
+		|| memcmp(h.magic, MATRIX_FILE_MAGIC, 4) != 0 || (h.dtype != MATRIX_F64 && h.dtype != MATRIX_F32)
+		|| (h.layout != MATRIX_ROW_MAJOR && h.layout != MATRIX_COL_MAJOR)
+		|| h.rows < 1 || h.cols < 1 || h.rows > INT_MAX || h.cols > INT_MAX
+		|| (length - sizeof(h)) / (h.dtype == MATRIX_F32 ? sizeof(float) : sizeof(double)) / h.rows < h.cols){
+		close(fd);
+		throw MatrixFileError();
+	}
+	int rows = h.rows, cols = h.cols;
+	if (h.dtype == MATRIX_F32){
+		std::shared_ptr<std::vector<float>> a = std::make_shared<std::vector<float>>((size_t)rows * cols);
+		size_t bytes = a->size() * sizeof(float);
+		bool ok = pread(fd, a->data(), bytes, sizeof(h)) == (ssize_t)bytes;
+		close(fd);
+		if (!ok)
+			throw MatrixFileError();
+		if (h.layout == MATRIX_ROW_MAJOR)
+			return ExprValue(rows, cols, a);
+		std::shared_ptr<std::vector<float>> t = std::make_shared<std::vector<float>>(a->size());
+		transpose(a->data(), rows, t->data(), cols, rows);
+		return ExprValue(rows, cols, t);
+	}
+	// Too large to map and work on in memory: copy it into tiles instead
+	if ((size_t)rows * cols * sizeof(double) > TiledMatrix::memoryLimit()){
+		std::shared_ptr<TiledMatrix> t;
+		try{
+			if (h.layout == MATRIX_ROW_MAJOR)
+				t = TiledMatrix::fromFile(fd, sizeof(h), rows, cols);
+			else
+				t = TiledMatrix::fromFile(fd, sizeof(h), cols, rows)->transpose();
+		}catch (const std::exception &e){
+			close(fd);
+			throw;
+		}
+		close(fd);
+		return ExprValue(t);
+	}
+	void *base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		throw MatrixFileError();
+	std::shared_ptr<MatBuffer> mapped = std::make_shared<MappedBuffer>(base, length, sizeof(h), (size_t)rows * cols);
+	if (h.layout == MATRIX_ROW_MAJOR)
+		return ExprValue(rows, cols, mapped);
+	ExprValue m(rows, cols);
+	double *out = m.Data();
+	const double *in = mapped->data();
+	for (int col = 0; col < cols; col++)
+		for (int row = 0; row < rows; row++)
+			out[(size_t)row * cols + col] = in[(size_t)col * rows + row];
+	return m;
+}
+
+size_t saveCsv(const ExprValue &m, const std::string &path){
+	std::ofstream out(path.c_str(), std::ios::binary);
+	const double *a = m.Data();
+	out << std::setprecision(17);
+	for (int row = 0; row < m.Rows(); row++)
+		for (int col = 0; col < m.Cols(); col++)
+			out << a[(size_t)row * m.Cols() + col] << (col + 1 < m.Cols() ? "," : "\n");
+	if (!out.flush())
+		throw MatrixFileError();
+	return (size_t)m.Rows() * m.Cols();
+}
+
+size_t saveBinary(const ExprValue &m, const std::string &path){
+	MatrixFileHeader h;
+	memcpy(h.magic, MATRIX_FILE_MAGIC, 4);
+	h.dtype = m.isF32() ? MATRIX_F32 : MATRIX_F64;
+	h.layout = MATRIX_ROW_MAJOR;
+	h.reserved = 0;
+	h.rows = m.Rows();
+	h.cols = m.Cols();
+	if (m.isTiled()){
+		int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			throw MatrixFileError();
+		try{
+			if (write(fd, &h, sizeof(h)) != sizeof(h))
+				throw MatrixFileError();
+			m.Tiles()->toFile(fd, sizeof(h));
+		}catch (const std::exception &e){
+			close(fd);
+			throw;
+		}
+		close(fd);
+		return h.rows * h.cols;
+	}
+	std::ofstream out(path.c_str(), std::ios::binary);
+	out.write((const char *)&h, sizeof(h));
+	if (m.isF32())
+		out.write((const char *)m.DataF32(), h.rows * h.cols * sizeof(float));
+	else
+		out.write((const char *)m.Data(), h.rows * h.cols * sizeof(double));
+	if (!out.flush())
+		throw MatrixFileError();
+	return h.rows * h.cols;
+}
+
+// Returns the number of elements written. They go to a temporary file next
+// to path which then replaces it: matrices loaded from the old file keep its
+// pages mapped, and truncating it under them would take those away.
+size_t saveMatrix(const ExprValue &m, const std::string &path){
+	if (!m.isMatrix())
+		throw ExprValue::InvalidOperand();
+	std::string tmp = path + ".tmp" + std::to_string(getpid());
+	size_t n;
+	try{
+		n = isCsv(path) ? saveCsv(m, tmp) : saveBinary(m, tmp);
+	}catch (const std::exception &e){
+		unlink(tmp.c_str());
+		throw;
+	}
+	if (rename(tmp.c_str(), path.c_str()) != 0){
+		unlink(tmp.c_str());
+		throw MatrixFileError();
+	}
+	return n;
+}
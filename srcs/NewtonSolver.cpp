@@ -0,0 +1,110 @@
+#include "NewtonSolver.hpp"
+#include <sstream>
+#include "Derivative.hpp"
+#include "Expression.hpp"
+#include "Utils.hpp"
+
+#define NEWTON_SAMPLES 256
+#define NEWTON_MAX_ITERATIONS 100
+
+bool isNaN(double x){
+	return x != x;
+}
+
+NewtonSolver::NewtonSolver(const exprnode *eq, const std::string &varname, double lo, double hi, double tolerance)
+	: lo(lo), hi(hi), tolerance(tolerance){
+	if (!eq || eq->opcode != '=')
+		return;
+	exprnode *fun = new exprnode(eq->left->clone(), '-', eq->right->clone());
+	bool compiled = f.compile(fun, varname);
+	if (compiled){
+		// Without a usable derivative the refinement is plain bisection.
+		try{
+			Expression deriv(derivative(fun, varname));
+			std::map<std::string, Expression *> nodefs;
+			deriv.Evaluate(nodefs);
+			df.compile(deriv.getRoot(), varname);
+		}catch (const std::exception &e){
+		}
+	}
+	delete fun;
+	if (!compiled)
+		return;
+	_solved = true;
+	double step = (hi - lo) / NEWTON_SAMPLES;
+	double x1 = lo, f1 = f(x1);
+	for (int k = 1; k <= NEWTON_SAMPLES; k++){
+		double x2 = k == NEWTON_SAMPLES ? hi : lo + k * step, f2 = f(x2);
+		double root;
+		if (f1 == 0)
+			addroot(x1);
+		else if (!isNaN(f1) && !isNaN(f2) && f2 != 0 && (f1 < 0) != (f2 < 0) && refine(x1, x2, f1, root))
+			addroot(root);
+		x1 = x2;
+		f1 = f2;
+	}
+	if (f1 == 0)
+		addroot(x1);
+}
+
+// Newton steps from the midpoint of [a, b], across which f changes sign.
+// Every step narrows the bracket to the side that keeps the sign change; a
+// Newton step that would leave it, or a bracket that did not at least halve
+// since the previous step, is replaced by bisection.
+bool NewtonSolver::refine(double a, double b, double fa, double &root) const{
+	double x = 0.5 * (a + b), width = abs(b - a);
+	for (int k = 0; k < NEWTON_MAX_ITERATIONS; k++){
+		double fx = f(x);
+		if (isNaN(fx))
+			return false;
+		if (fx == 0)
+			break;
+		if ((fx < 0) == (fa < 0)){
+			a = x;
+			fa = fx;
+		}else
+			b = x;
+		double next = x - fx / df(x);
+		bool inside = (next - a) * (next - b) < 0;
+		if (!inside || abs(b - a) > 0.5 * width)
+			next = 0.5 * (a + b);
+		width = abs(b - a);
+		double step = abs(next - x);
+		x = next;
+		if (step < tolerance || width == 0)
+			break;
+	}
+	// a sign change across a pole converges onto the pole itself
+	double fx = f(x);
+	if (isNaN(fx) || abs(fx) > sqrt(tolerance))
+		return false;
+	root = x;
+	return true;
+}
+
+void NewtonSolver::addroot(double x){
+	if (!roots.empty() && abs(roots.back().at(0) - x) <= tolerance * 10)
+		return;
+	if (abs(x) < tolerance)
+		x = 0;
+	roots.push_back({{0, x}});
+}
+
+bool NewtonSolver::getSolved() const{
+	return _solved;
+}
+
+std::string NewtonSolver::getMsg() const{
+	std::stringstream ss;
+	ss << "The equation is not polynomial. ";
+	if (roots.empty())
+		ss << "Newton iterations found no solutions in [" << fixedout(lo) << ", " << fixedout(hi) << "].";
+	else
+		ss << "Newton iterations found " << roots.size() << " solution" << (roots.size() > 1 ? "s" : "")
+		   << " in [" << fixedout(lo) << ", " << fixedout(hi) << "]:";
+	return ss.str();
+}
+
+const std::vector<std::map<double, double>> &NewtonSolver::getRoots() const{
+	return roots;
+}
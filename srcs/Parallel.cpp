@@ -0,0 +1,31 @@
+#include "Parallel.hpp"
+#include <thread>
+#include <vector>
+
+int threadCount(){
+	int n = std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &body){
+	int n = end - begin, chunks = threadCount();
+	if (grain < 1)
+		grain = 1;
+	if (chunks > n / grain)
+		chunks = n / grain;
+	if (chunks < 2){
+		if (n > 0)
+			body(begin, end);
+		return;
+	}
+	std::vector<std::thread> workers;
+	int from = begin;
+	for (int k = 0; k < chunks - 1; k++){
+		int to = from + (end - from) / (chunks - k);
+		workers.push_back(std::thread(body, from, to));
+		from = to;
+	}
+	body(from, end);
+	for (auto &t : workers)
+		t.join();
+}
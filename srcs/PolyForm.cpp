@@ -0,0 +1,416 @@
+#include "PolyForm.hpp"
+#include <algorithm>
+#include "Utils.hpp"
+
+#define POLYFORM_MAX_EXPONENT 1000000LL
+#define POLYFORM_MAX_EXPAND 256
+#define POLYFORM_MAX_TERMS 10000
+#define POLYFORM_SPARSE_RATIO 16
+
+size_t PolyForm::MonomialHash::operator()(const Monomial &m) const{
+	size_t h = m.size();
+	for (int e : m)
+		h ^= (size_t)e + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+	return h;
+}
+
+PolyForm::Atoms::Atoms(){}
+
+PolyForm::Atoms::~Atoms(){
+	for (auto node : nodes)
+		delete node;
+}
+
+int PolyForm::Atoms::get(const exprnode *node){
+	std::string key = node->Print();
+	auto it = ids.find(key);
+	if (it != ids.end())
+		return it->second;
+	int id = names.size();
+	ids[key] = id;
+	names.push_back(key);
+	nodes.push_back(node->clone());
+	return id;
+}
+
+const std::string &PolyForm::Atoms::name(int id) const{
+	return names[id];
+}
+
+const exprnode *PolyForm::Atoms::node(int id) const{
+	return nodes[id];
+}
+
+int PolyForm::Atoms::size() const{
+	return names.size();
+}
+
+PolyForm::PolyForm(){}
+
+PolyForm::PolyForm(const ExprValue &c){
+	add(Monomial(), c);
+}
+
+PolyForm::PolyForm(const Monomial &m, const ExprValue &c){
+	add(m, c);
+}
+
+PolyForm::PolyForm(const PolyForm &other) : t(other.t){}
+
+PolyForm &PolyForm::operator=(const PolyForm &other){
+	if (this == &other)
+		return (*this);
+	t = other.t;
+	return (*this);
+}
+
+PolyForm::~PolyForm(){}
+
+PolyForm PolyForm::atom(int id){
+	Monomial m(id + 1, 0);
+	m[id] = 1;
+	return PolyForm(m, ExprValue(1., 0.));
+}
+
+PolyForm PolyForm::fromDense(const DensePoly &d, int id){
+	PolyForm r;
+	r.t.reserve(d.degree() + 1);
+	for (int k = 0; k <= d.degree(); k++){
+		Monomial m;
+		if (k > 0){
+			m.assign(id + 1, 0);
+			m[id] = k;
+		}
+		r.add(m, d.coef(k));
+	}
+	return r;
+}
+
+void PolyForm::add(const Monomial &m, const ExprValue &c){
+	if (c == ExprValue())
+		return;
+	auto it = t.find(m);
+	if (it == t.end()){
+		t.emplace(m, c);
+		return;
+	}
+	it->second = it->second + c;
+	if (it->second == ExprValue())
+		t.erase(it);
+}
+
+PolyForm PolyForm::operator+(const PolyForm &rhs) const{
+	const PolyForm &big = t.size() >= rhs.t.size() ? *this : rhs;
+	const PolyForm &small = &big == this ? rhs : *this;
+	PolyForm r(big);
+	for (auto &term : small.t)
+		r.add(term.first, term.second);
+	return r;
+}
+
+PolyForm PolyForm::operator-(const PolyForm &rhs) const{
+	PolyForm r(*this);
+	for (auto &term : rhs.t)
+		r.add(term.first, ExprValue() - term.second);
+	return r;
+}
+
+// Exponents past POLYFORM_MAX_EXPONENT saturate just beyond it, so the
+// product stays out of range for bounded() instead of wrapping around.
+PolyForm::Monomial mulMonomial(const PolyForm::Monomial &a, const PolyForm::Monomial &b){
+	PolyForm::Monomial m(a.size() > b.size() ? a : b);
+	const PolyForm::Monomial &s = a.size() > b.size() ? b : a;
+	for (size_t k = 0; k < s.size(); k++){
+		long long e = (long long)m[k] + s[k];
+		m[k] = (int)std::max(-POLYFORM_MAX_EXPONENT - 1, std::min(POLYFORM_MAX_EXPONENT + 1, e));
+	}
+	while (!m.empty() && m.back() == 0)
+		m.pop_back();
+	return m;
+}
+
+PolyForm PolyForm::operator*(const PolyForm &rhs) const{
+	PolyForm r;
+	r.t.reserve(t.size() * rhs.t.size());
+	for (auto &x : t)
+		for (auto &y : rhs.t)
+			r.add(mulMonomial(x.first, y.first), x.second * y.second);
+	return r;
+}
+
+PolyForm PolyForm::pow(long long p) const{
+	PolyForm r(ExprValue(1., 0.));
+	PolyForm x(*this);
+	for (; p > 0; p >>= 1){
+		if (p & 1)
+			r = r * x;
+		if (p > 1)
+			x = x * x;
+	}
+	return r;
+}
+
+bool PolyForm::isMonomial() const{
+	return t.size() == 1;
+}
+
+bool PolyForm::isConst() const{
+	return t.empty() || (t.size() == 1 && t.begin()->first.empty());
+}
+
+bool PolyForm::isUnivariate(int &id) const{
+	id = -1;
+	for (auto &term : t){
+		const Monomial &m = term.first;
+		if (m.empty())
+			continue;
+		for (size_t k = 0; k + 1 < m.size(); k++)
+			if (m[k] != 0)
+				return false;
+		if (m.back() < 0 || (id != -1 && id != (int)m.size() - 1))
+			return false;
+		id = m.size() - 1;
+	}
+	return id != -1;
+}
+
+DensePoly PolyForm::toDense(int id) const{
+	int deg = 0;
+	for (auto &term : t)
+		deg = max(deg, term.first.empty() ? 0 : term.first[id]);
+	std::vector<double> re(deg + 1, 0.), im(deg + 1, 0.);
+	for (auto &term : t){
+		int k = term.first.empty() ? 0 : term.first[id];
+		re[k] = term.second.Re();
+		im[k] = term.second.Im();
+	}
+	return DensePoly(re, im);
+}
+
+size_t PolyForm::size() const{
+	return t.size();
+}
+
+const PolyForm::Terms &PolyForm::terms() const{
+	return t;
+}
+
+bool hasMatrix(const exprnode *root){
+	if (!root)
+		return false;
+	if (root->opcode == 'c')
+		return root->value.isMatrix();
+	return hasMatrix(root->left) || hasMatrix(root->right);
+}
+
+bool opaqueAtom(const exprnode *root, PolyForm &out, PolyForm::Atoms &atoms){
+	exprnode *node = root->clone();
+	PolyForm::normalize(node->left);
+	PolyForm::normalize(node->right);
+	out = PolyForm::atom(atoms.get(node));
+	delete node;
+	return true;
+}
+
+bool invertMonomial(const PolyForm &p, PolyForm &out){
+	if (!p.isMonomial() || p.terms().begin()->second == ExprValue())
+		return false;
+	PolyForm::Monomial m(p.terms().begin()->first);
+	for (auto &e : m)
+		e = -e;
+	out = PolyForm(m, ExprValue(1., 0.) / p.terms().begin()->second);
+	return true;
+}
+
+// The largest exponent magnitude of any atom in p.
+long long maxExponent(const PolyForm &p){
+	long long r = 0;
+	for (auto &term : p.terms())
+		for (int e : term.first)
+			r = std::max(r, (long long)(e < 0 ? -e : e));
+	return r;
+}
+
+// At most POLYFORM_MAX_TERMS terms, exponents within POLYFORM_MAX_EXPONENT
+// and finite coefficients; sums, products and powers past any of these are
+// kept as opaque atoms instead.
+bool bounded(const PolyForm &p){
+	if (p.size() > POLYFORM_MAX_TERMS || maxExponent(p) > POLYFORM_MAX_EXPONENT)
+		return false;
+	for (auto &term : p.terms()){
+		double re = term.second.Re(), im = term.second.Im();
+		if (re - re != 0 || im - im != 0)
+			return false;
+	}
+	return true;
+}
+
+bool PolyForm::fromTree(const exprnode *root, PolyForm &out, Atoms &atoms){
+	PolyForm l, r;
+	switch (root->opcode){
+	case 'c':
+		if (root->value.isMatrix())
+			return false;
+		out = PolyForm(root->value);
+		return true;
+	case 'v':
+		out = atom(atoms.get(root));
+		return true;
+	case '+':
+	case '-':
+	case '*':
+		if (!fromTree(root->left, l, atoms) || !fromTree(root->right, r, atoms))
+			return false;
+		out = root->opcode == '+' ? l + r : root->opcode == '-' ? l - r : l * r;
+		return bounded(out) || opaqueAtom(root, out, atoms);
+	case '/':
+		if (!fromTree(root->left, l, atoms) || !fromTree(root->right, r, atoms))
+			return false;
+		if (!invertMonomial(r, r))
+			return opaqueAtom(root, out, atoms);
+		out = l * r;
+		return bounded(out) || opaqueAtom(root, out, atoms);
+	case '^':
+		if (root->right->opcode == 'c' && root->right->value.isReal() &&
+			root->right->value.Re() == (int)root->right->value.Re() &&
+			abs(root->right->value.Re()) <= POLYFORM_MAX_EXPONENT){
+			long long p = (long long)root->right->value.Re();
+			if (!fromTree(root->left, l, atoms))
+				return false;
+			if (p < 0 && invertMonomial(l, l))
+				p = -p;
+			// the bound on the terms of the power, C(p + k - 1, k - 1) for k terms
+			double terms = DensePoly::powerTerms(l.size(), p, POLYFORM_MAX_TERMS);
+			bool expand = p >= 0 && maxExponent(l) * p <= POLYFORM_MAX_EXPONENT &&
+				(l.isMonomial() || (p <= POLYFORM_MAX_EXPAND && terms <= POLYFORM_MAX_TERMS));
+			int id;
+			if (p > 1 && !l.isMonomial() && l.isUnivariate(id)){
+				long long degree = 0;
+				for (auto &term : l.terms())
+					degree = std::max(degree, term.first.empty() ? 0LL : term.first[id] * p);
+				// dense unless the power stays sparse, like (x^1000 + 1)^100
+				if (degree < POLYFORM_MAX_TERMS && !(expand && terms * POLYFORM_SPARSE_RATIO < degree)){
+					DensePoly d = l.toDense(id).pow(p);
+					if (!d.isFinite())
+						return opaqueAtom(root, out, atoms);
+					out = fromDense(d, id);
+					return true;
+				}
+			}
+			if (expand){
+				out = l.pow(p);
+				if (bounded(out))
+					return true;
+			}
+		}
+		return opaqueAtom(root, out, atoms);
+	}
+	return opaqueAtom(root, out, atoms);
+}
+
+std::vector<int> atomOrder(const PolyForm::Atoms &atoms){
+	std::vector<int> order(atoms.size());
+	for (int k = 0; k < atoms.size(); k++)
+		order[k] = k;
+	std::sort(order.begin(), order.end(), [&atoms](int a, int b){
+		bool va = atoms.node(a)->opcode == 'v', vb = atoms.node(b)->opcode == 'v';
+		if (va != vb)
+			return va;
+		return atoms.name(a) < atoms.name(b);
+	});
+	return order;
+}
+
+int exponent(const PolyForm::Monomial &m, int id){
+	return id < (int)m.size() ? m[id] : 0;
+}
+
+exprnode *mulNode(exprnode *lhs, exprnode *rhs){
+	return lhs ? new exprnode(lhs, '*', rhs) : rhs;
+}
+
+exprnode *termTree(const PolyForm::Monomial &m, const ExprValue &c,
+				   const PolyForm::Atoms &atoms, const std::vector<int> &order){
+	exprnode *num = NULL, *den = NULL;
+	for (int id : order){
+		int e = exponent(m, id);
+		if (e == 0)
+			continue;
+		exprnode *factor = atoms.node(id)->clone();
+		if (e > 1 || e < -1)
+			factor = new exprnode(factor, '^', new exprnode(ExprValue((double)(e < 0 ? -e : e), 0.)));
+		if (e > 0)
+			num = mulNode(num, factor);
+		else
+			den = mulNode(den, factor);
+	}
+	if (!num)
+		num = new exprnode(c);
+	else if (c != ExprValue(1., 0.))
+		num = new exprnode(new exprnode(c), '*', num);
+	return den ? new exprnode(num, '/', den) : num;
+}
+
+exprnode *PolyForm::toTree(const Atoms &atoms) const{
+	if (t.empty())
+		return new exprnode(ExprValue());
+	std::vector<int> order = atomOrder(atoms);
+	std::vector<const Terms::value_type *> terms;
+	terms.reserve(t.size());
+	for (auto &term : t)
+		terms.push_back(&term);
+	std::sort(terms.begin(), terms.end(), [&order](const Terms::value_type *a, const Terms::value_type *b){
+		int da = 0, db = 0;
+		for (int e : a->first)
+			da += e;
+		for (int e : b->first)
+			db += e;
+		if (da != db)
+			return da > db;
+		for (int id : order)
+			if (exponent(a->first, id) != exponent(b->first, id))
+				return exponent(a->first, id) > exponent(b->first, id);
+		return false;
+	});
+	exprnode *expr = NULL;
+	for (auto term : terms){
+		const ExprValue &c = term->second;
+		bool negative = expr && (c.Re() < 0 || (c.Re() == 0 && c.Im() < 0));
+		exprnode *node = termTree(term->first, negative ? ExprValue() - c : c, atoms, order);
+		expr = expr ? new exprnode(expr, negative ? '-' : '+', node) : node;
+	}
+	return expr;
+}
+
+void PolyForm::normalize(exprnode *root){
+	if (!root || root->opcode == 'c' || root->opcode == 'v' || root->opcode == 's')
+		return;
+	PolyForm p;
+	Atoms atoms;
+	DensePoly dense;
+	std::string var;
+	if (root->opcode == '=' || hasMatrix(root)){
+		normalize(root->left);
+		normalize(root->right);
+		return;
+	}
+	if (DensePoly::fromTree(root, dense, var) && dense.degree() < POLYFORM_MAX_TERMS){
+		exprnode v('v', var);
+		p = var.empty() ? PolyForm(dense.coef(0)) : fromDense(dense, atoms.get(&v));
+	}else if (!fromTree(root, p, atoms)){
+		normalize(root->left);
+		normalize(root->right);
+		return;
+	}
+	exprnode *tree = p.toTree(atoms);
+	delete root->left;
+	delete root->right;
+	root->opcode = tree->opcode;
+	root->value = tree->value;
+	root->varname = tree->varname;
+	root->left = tree->left;
+	root->right = tree->right;
+	tree->left = NULL;
+	tree->right = NULL;
+	delete tree;
+}
@@ -1,7 +1,11 @@
 #include "PolySolver.hpp"
+#include <cmath>
 #include <sstream>
 #include "Utils.hpp"
 
+#define ABERTH_MAX_ITERATIONS 1000
+#define CLUSTER_TOLERANCE 1e-12
+
 PolySolver::PolySolver():_solved(false){}
 
 PolySolver::PolySolver(int ac, char **av){
@@ -16,6 +20,26 @@ PolySolver::PolySolver(std::string &eq)
 	init(eq);
 }
 
+PolySolver::PolySolver(const exprnode *eq){
+	if (!eq || eq->opcode != '='){
+		error("Can't read equation.");
+		return;
+	}
+	if (!readPolynom(eq))
+		return;
+	_solved = true;
+	if (!checkDegree())
+		return;
+	solve();
+}
+
+PolySolver::PolySolver(const DensePoly &poly) : poly(poly){
+	_solved = true;
+	if (!checkDegree())
+		return;
+	solve();
+}
+
 void PolySolver::init(std::string &eq){
 	if (!readEquation(eq))
 		return;
@@ -71,75 +95,65 @@ bool PolySolver::readEquation(std::string &s){
 	}
 	if (!_expr || _expr->getRoot()->opcode != '=')
 		return error("Can't read equation.");
-	if (_expr->getVars().size() > 1){
-		std::stringstream ss;
-		ss << "There are " << _expr->getVars().size() << " variables in equation, i can't solve.";
-		return error(ss.str());
-	}
-	_expr->Reduce();
+	return readPolynom(_expr->getRoot());
+}
+
+// Both sides are collected in one pass each into dense coefficient arrays.
+bool PolySolver::readPolynom(const exprnode *eq){
+	DensePoly lhs, rhs;
+	if (!DensePoly::fromTree(eq->left, lhs, varname) ||
+		!DensePoly::fromTree(eq->right, rhs, varname))
+		return diagnose(eq);
+	poly = lhs - rhs;
 	return true;
 }
 
-void collect_polynom(const exprnode *root, std::map<double, Expression::VALUE_TYPE> &polynom, int sign = 1)
-{
-	char c = root->opcode;
-	if (c == '+' || c == '-')
-	{
-		collect_polynom(root->left, polynom, sign);
-		collect_polynom(root->right, polynom, sign * (c == '+' ? 1 : -1));
-	}
-	else if (c == 'c')
-		polynom[0] += sign * root->value.Re();
-	else if (c == '^')
-		polynom[root->right->value.Re()] += sign;
-	else if (c == '*'){
-		exprnode *coef = root->left->opcode == 'c' ? root->left : root->right;
-		exprnode *pwr = coef == root->right ? root->left : root->right;
-		double power = 1;
-		if (pwr->opcode != 'v')
-			power = pwr->right->value.Re();
-		polynom[power] += sign * coef->value.Re();
+void scanEquation(const exprnode *root, std::set<std::string> &vars, bool &negative, bool &fractional){
+	if (!root)
+		return;
+	if (root->opcode == 'v')
+		vars.insert(root->varname);
+	if (root->opcode == '^' && root->right->opcode == 'c' && root->right->value.isReal()){
+		if (root->right->value.Re() < 0)
+			negative = true;
+		else if (root->right->value.Re() != (int)root->right->value.Re())
+			fractional = true;
 	}
-	else if (c == 'v')
-		polynom[1] += sign;
+	if (root->opcode == '/' && root->right->opcode != 'c')
+		negative = true;
+	scanEquation(root->left, vars, negative, fractional);
+	scanEquation(root->right, vars, negative, fractional);
 }
 
-bool PolySolver::checkDegree(){
-	collect_polynom(_expr->getRoot()->left, polynom);
-	int mindeg = 32768;
-	deg = 0;
-	bool fractional_power = false;
-	for (auto i : polynom)
-	{
-		if (i.second == 0)
-			continue;
-		if (i.first > deg)
-			deg = i.first;
-		if (i.first < mindeg)
-			mindeg = i.first;
-		if (i.first == (double)2)
-			a = i.second;
-		else if (i.first == (double)1)
-			b = i.second;
-		else if (i.first == (double)0)
-			c = i.second;
-		else
-			fractional_power = true;
+// Only reached when the equation is not a univariate polynomial.
+bool PolySolver::diagnose(const exprnode *eq){
+	std::set<std::string> vars;
+	bool negative = false, fractional = false;
+	scanEquation(eq, vars, negative, fractional);
+	if (vars.size() > 1){
+		std::stringstream ss;
+		ss << "There are " << vars.size() << " variables in equation, i can't solve.";
+		return error(ss.str());
 	}
-	if (mindeg < 0)
+	if (negative)
 		return error("Negative degree detected, I can't solve.");
-	if (deg > 2)
-		return error("The polynomial degree is strictly greater than 2, I can't solve.");
-	if (fractional_power)
+	if (fractional)
 		return error("Fractional power detected, I can't solve.");
-	for (int k = 1; k < 3;k++)
-		if(polynom[(double)k]==0)
-			polynom.erase((double)k);
+	return error("The equation is not polynomial, I can't solve.");
+}
+
+bool PolySolver::checkDegree(){
+	deg = max(poly.degree(), 0);
+	if (poly.isReal() && deg <= 2){
+		a = poly.coef(2).Re();
+		b = poly.coef(1).Re();
+		c = poly.coef(0).Re();
+	}
 	return true;
 }
 
 std::string PolySolver::getTree() const{
-	return _expr->treePrint();
+	return _expr ? _expr->treePrint() : "";
 }
 
 bool PolySolver::explane() const {
@@ -151,10 +165,12 @@ Expression::VALUE_TYPE PolySolver::getDiscriminant() const{
 }
 
 std::string PolySolver::reducedForm() const{
-	std::string var = "X";
-	if (_expr->getVars().size() > 0)
-		var = *(_expr->getVars().begin());
-	return printPolynom(polynom, var);
+	std::map<double, double> polynom;
+	polynom[0] = poly.coef(0).Re();
+	for (int k = 1; k <= poly.degree(); k++)
+		if (poly.coef(k).Re() != 0)
+			polynom[k] = poly.coef(k).Re();
+	return printPolynom(polynom, varname.empty() ? "X" : varname);
 }
 
 bool check_root(Expression::VALUE_TYPE re,
@@ -182,9 +198,11 @@ const std::vector<std::map<double, Expression::VALUE_TYPE>> &PolySolver::getRoot
 
 void PolySolver::solve()
 {
-	if (deg == 0)
+	if (deg > 2 || !poly.isReal())
+		solveAberth();
+	else if (deg == 0)
 	{
-		if (c != 0)
+		if (poly.degree() == 0)
 			_errmsg = "There is no solution.";
 		else
 			_errmsg = "The solution is each real number.";
@@ -234,6 +252,297 @@ void PolySolver::solve()
 	}
 }
 
+// Relative residual |p(z)| / sum |c_k||z|^k. For |z| > 1 the reversed
+// polynomial is evaluated at 1/z, which gives the same ratio without overflow.
+double PolySolver::residual(double re, double im) const{
+	const std::vector<double> &cr = poly.Re(), &ci = poly.Im();
+	int n = poly.degree();
+	bool rev = re * re + im * im > 1;
+	if (rev){
+		double m = re * re + im * im;
+		re /= m;
+		im = -im / m;
+	}
+	double pr = 0, pi = 0, scale = 0, r = sqrt(re * re + im * im);
+	for (int k = 0; k <= n; k++){
+		int j = rev ? k : n - k;
+		double t = pr * re - pi * im + cr[j];
+		pi = pr * im + pi * re + ci[j];
+		pr = t;
+		scale = scale * r + sqrt(cr[j] * cr[j] + ci[j] * ci[j]);
+	}
+	return scale == 0 ? 0 : sqrt(pr * pr + pi * pi) / scale;
+}
+
+// Aberth-Ehrlich simultaneous iteration. All corrections of a sweep are
+// computed from the previous approximations (Jacobi style) over separate
+// real/imaginary arrays and applied afterwards.
+void PolySolver::solveAberth(){
+	int zeros = 0;
+	while (poly.Re()[zeros] == 0 && poly.Im()[zeros] == 0)
+		zeros++;
+	std::vector<double> cr(poly.Re().begin() + zeros, poly.Re().end());
+	std::vector<double> ci(poly.Im().begin() + zeros, poly.Im().end());
+	int n = cr.size() - 1;
+	double lr = cr[n], li = ci[n], lm = lr * lr + li * li;
+	for (int k = 0; k <= n; k++){
+		double t = (cr[k] * lr + ci[k] * li) / lm;
+		ci[k] = (ci[k] * lr - cr[k] * li) / lm;
+		cr[k] = t;
+	}
+	std::vector<double> zr(n), zi(n), dr(n), di(n);
+	std::vector<bool> done(n, false);
+	// the geometric mean of the roots' moduli, |c0|^(1/n), taken apart as
+	// m * 2^e so that pow only ever sees arguments near 1
+	double radius = 0;
+	if (n > 0){
+		int e;
+		double m = std::frexp(sqrt(cr[0] * cr[0] + ci[0] * ci[0]), &e);
+		int q = e >= 0 ? e / n : -((n - 1 - e) / n);
+		radius = std::ldexp(pow(m, 1. / n) * pow(2., (double)(e - q * n) / n), q);
+	}
+	for (int k = 0; k < n; k++){
+		zr[k] = radius * cos(2 * FT_PI * k / n + 0.4);
+		zi[k] = radius * sin(2 * FT_PI * k / n + 0.4);
+	}
+	int converged = 0;
+	for (int its = 0; its < ABERTH_MAX_ITERATIONS && converged < n; its++){
+		for (int k = 0; k < n; k++){
+			dr[k] = di[k] = 0;
+			if (done[k])
+				continue;
+			double xr = zr[k], xi = zi[k], m = xr * xr + xi * xi;
+			bool rev = m > 1;
+			double yr = rev ? xr / m : xr, yi = rev ? -xi / m : xi;
+			// p and p' (or the reversed q and q') by Horner's scheme
+			double pr = 0, pi = 0, qr = 0, qi = 0, bound = 0, ym = sqrt(yr * yr + yi * yi);
+			for (int j = 0; j <= n; j++){
+				int idx = rev ? j : n - j;
+				double t = qr * yr - qi * yi + pr;
+				qi = qr * yi + qi * yr + pi;
+				qr = t;
+				t = pr * yr - pi * yi + cr[idx];
+				pi = pr * yi + pi * yr + ci[idx];
+				pr = t;
+				bound = bound * ym + sqrt(cr[idx] * cr[idx] + ci[idx] * ci[idx]);
+			}
+			// stop once p(z) is at the rounding level of Horner's scheme
+			if (sqrt(pr * pr + pi * pi) <= 4e-16 * (n + 1) * bound){
+				done[k] = true;
+				converged++;
+				continue;
+			}
+			// w = p / p'; reversed: w = z q / (n q - y q')
+			double nr = pr, ni = pi, er = qr, ei = qi;
+			if (rev){
+				er = n * pr - (yr * qr - yi * qi);
+				ei = n * pi - (yr * qi + yi * qr);
+				nr = xr * pr - xi * pi;
+				ni = xr * pi + xi * pr;
+			}
+			double em = er * er + ei * ei;
+			double wr = (nr * er + ni * ei) / em, wi = (ni * er - nr * ei) / em;
+			double sr = 0, si = 0;
+			for (int j = 0; j < n; j++){
+				if (j == k)
+					continue;
+				double ur = xr - zr[j], ui = xi - zi[j], um = ur * ur + ui * ui;
+				sr += ur / um;
+				si -= ui / um;
+			}
+			double fr = 1 - (wr * sr - wi * si), fi = -(wr * si + wi * sr), fm = fr * fr + fi * fi;
+			dr[k] = (wr * fr + wi * fi) / fm;
+			di[k] = (wi * fr - wr * fi) / fm;
+		}
+		for (int k = 0; k < n; k++){
+			if (done[k])
+				continue;
+			zr[k] -= dr[k];
+			zi[k] -= di[k];
+			double scale = 1 + sqrt(zr[k] * zr[k] + zi[k] * zi[k]);
+			if (sqrt(dr[k] * dr[k] + di[k] * di[k]) <= _precision * 1e-6 * scale){
+				done[k] = true;
+				converged++;
+			}
+		}
+	}
+	std::stringstream ss;
+	ss << "The polynomial degree is " << deg << ".";
+	for (int k = 0; k < n; k++)
+		if (residual(zr[k], zi[k]) > _precision){
+			ss << " There are " << deg << " solutions, but i can't calculate them precise enough.";
+			_errmsg = ss.str();
+			return;
+		}
+	if (!mergeClusters(cr, ci, zr, zi)){
+		ss << " There are " << deg << " solutions, but i can't calculate them precise enough.";
+		_errmsg = ss.str();
+		return;
+	}
+	for (int k = 0; k < n && poly.isReal(); k++)
+		if (abs(zi[k]) <= _precision * (1 + abs(zr[k])))
+			zi[k] = 0;
+	zr.insert(zr.end(), zeros, 0.);
+	zi.insert(zi.end(), zeros, 0.);
+	n += zeros;
+	std::vector<int> order(n);
+	for (int k = 0; k < n; k++)
+		order[k] = k;
+	std::sort(order.begin(), order.end(), [&zr, &zi](int x, int y){
+		if ((zi[x] == 0) != (zi[y] == 0))
+			return zi[x] == 0;
+		if (zr[x] != zr[y])
+			return zr[x] < zr[y];
+		return zi[x] < zi[y];
+	});
+	for (int k : order)
+		addroot(zr[k], zi[k]);
+	ss << " The solutions are:";
+	_errmsg = ss.str();
+}
+
+// log(|p(z)| + e) for the monic p, e the rounding error bound of Horner's
+// scheme. For |z| > 1 the reversed polynomial is evaluated at 1/z and
+// n log|z| added back, so that neither overflows at high degrees.
+static double logAbs(const std::vector<double> &cr, const std::vector<double> &ci, double xr, double xi){
+	int n = cr.size() - 1;
+	double m = xr * xr + xi * xi, shift = 0;
+	bool rev = m > 1;
+	if (rev){
+		shift = n * std::log(m) / 2;
+		xr /= m;
+		xi = -xi / m;
+	}
+	double pr = 0, pi = 0, bound = 0, r = sqrt(xr * xr + xi * xi);
+	for (int k = 0; k <= n; k++){
+		int j = rev ? k : n - k;
+		double t = pr * xr - pi * xi + cr[j];
+		pi = pr * xi + pi * xr + ci[j];
+		pr = t;
+		bound = bound * r + sqrt(cr[j] * cr[j] + ci[j] * ci[j]);
+	}
+	return shift + std::log(sqrt(pr * pr + pi * pi) + 4e-16 * (n + 1) * bound);
+}
+
+// A root of multiplicity m only comes out to about eps^(1/m), as a cluster of
+// m approximations. The disc of radius n |p(z_k)| / |prod (z_k - z_j)| about
+// each approximation holds a root, and a connected union of m such discs
+// apart from the others holds exactly m; those unions are the clusters. The
+// centroid of a cluster is far more accurate; it replaces the cluster when
+// the first m Taylor coefficients of p at it vanish. Otherwise the cluster
+// stands as it is, which is only good enough while the union of its discs
+// is within _precision; false when it is not. Lone roots have passed the
+// residual check already.
+bool PolySolver::mergeClusters(const std::vector<double> &cr, const std::vector<double> &ci,
+							   std::vector<double> &zr, std::vector<double> &zi) const{
+	int n = zr.size();
+	std::vector<double> radius(n);
+	for (int k = 0; k < n; k++){
+		double logr = std::log((double)n) + logAbs(cr, ci, zr[k], zi[k]);
+		for (int j = 0; j < n; j++)
+			if (j != k)
+				logr -= std::log(sqrt((zr[k] - zr[j]) * (zr[k] - zr[j]) + (zi[k] - zi[j]) * (zi[k] - zi[j])));
+		radius[k] = std::exp(logr);
+	}
+	std::vector<int> cluster(n, -1);
+	for (int k = 0; k < n; k++){
+		if (cluster[k] != -1)
+			continue;
+		cluster[k] = k;
+		std::vector<int> members(1, k);
+		for (size_t i = 0; i < members.size(); i++){
+			int c = members[i];
+			for (int j = k + 1; j < n; j++)
+				if (cluster[j] == -1 && sqrt((zr[j] - zr[c]) * (zr[j] - zr[c]) + (zi[j] - zi[c]) * (zi[j] - zi[c])) <=
+											radius[j] + radius[c]){
+					cluster[j] = k;
+					members.push_back(j);
+				}
+		}
+		int m = members.size();
+		if (m == 1)
+			continue;
+		double xr = 0, xi = 0;
+		for (int j : members){
+			xr += zr[j];
+			xi += zi[j];
+		}
+		xr /= m;
+		xi /= m;
+		double cxr = xr, cxi = xi;
+		// how far the union of the discs reaches from the centroid
+		double extent = 0;
+		for (int j : members)
+			extent = std::max(extent, sqrt((zr[j] - xr) * (zr[j] - xr) + (zi[j] - xi) * (zi[j] - xi)) + radius[j]);
+		bool precise = extent <= _precision * (1 + sqrt(xr * xr + xi * xi));
+		// an m-fold root of p is a simple root of p^(m-1): polish it by Newton
+		std::vector<double> dr(cr), di(ci);
+		for (int t = 1; t < m; t++){
+			for (size_t j = 1; j < dr.size(); j++){
+				dr[j - 1] = dr[j] * j;
+				di[j - 1] = di[j] * j;
+			}
+			dr.pop_back();
+			di.pop_back();
+		}
+		double step = 0;
+		for (int its = 0; its < 50; its++){
+			double pr = 0, pi = 0, qr = 0, qi = 0;
+			for (int j = dr.size() - 1; j >= 0; j--){
+				double t = qr * xr - qi * xi + pr;
+				qi = qr * xi + qi * xr + pi;
+				qr = t;
+				t = pr * xr - pi * xi + dr[j];
+				pi = pr * xi + pi * xr + di[j];
+				pr = t;
+			}
+			double qm = qr * qr + qi * qi;
+			if (qm == 0)
+				break;
+			double sr = (pr * qr + pi * qi) / qm, si = (pi * qr - pr * qi) / qm;
+			xr -= sr;
+			xi -= si;
+			step = sqrt(sr * sr + si * si);
+			if (step <= 1e-16 * (1 + sqrt(xr * xr + xi * xi)))
+				break;
+		}
+		// Taylor coefficients at the centroid by repeated synthetic division
+		std::vector<double> br(cr), bi(ci);
+		bool multiple = true;
+		double xm = sqrt(xr * xr + xi * xi);
+		for (int t = 0; t < m && multiple; t++){
+			int len = br.size();
+			double rr = br[len - 1], ri = bi[len - 1];
+			double bound = sqrt(rr * rr + ri * ri);
+			std::vector<double> qr(len - 1), qi(len - 1);
+			for (int j = len - 2; j >= 0; j--){
+				qr[j] = rr;
+				qi[j] = ri;
+				double tr = rr * xr - ri * xi + br[j];
+				ri = rr * xi + ri * xr + bi[j];
+				rr = tr;
+				bound = bound * xm + sqrt(br[j] * br[j] + bi[j] * bi[j]);
+			}
+			multiple = sqrt(rr * rr + ri * ri) <= CLUSTER_TOLERANCE * bound;
+			br.swap(qr);
+			bi.swap(qi);
+		}
+		// the polished root has to have settled, within the discs
+		multiple = multiple && step <= _precision * (1 + xm) &&
+				   sqrt((xr - cxr) * (xr - cxr) + (xi - cxi) * (xi - cxi)) <= extent;
+		if (!multiple){
+			if (!precise)
+				return false;
+			continue;
+		}
+		for (int j : members){
+			zr[j] = xr;
+			zi[j] = xi;
+		}
+	}
+	return true;
+}
+
 bool PolySolver::getSolved() const
 {
 	return _solved;
@@ -264,6 +573,8 @@ PolySolver &PolySolver::operator=(const PolySolver &other)
 	roots = other.roots;
 	_precision = other._precision;
 	deg = other.deg;
+	poly = other.poly;
+	varname = other.varname;
 	return (*this);
 }
 
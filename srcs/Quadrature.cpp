@@ -0,0 +1,131 @@
+#include "Quadrature.hpp"
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "Parallel.hpp"
+
+#define INTEGRATE_EPSABS 1e-12
+#define INTEGRATE_EPSREL 1e-10
+#define INTEGRATE_LIMIT 2000
+// at most this many intervals bisected per round, those within
+// INTEGRATE_SPLIT_RATIO of the largest error
+#define INTEGRATE_SPLIT 32
+#define INTEGRATE_SPLIT_RATIO 0.1
+#define INTEGRATE_GRAIN 8
+#define KRONROD_NODES 15
+
+static const double xgk[8] = {
+	0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245, 0.000000000000000000000000000000000};
+static const double wgk[8] = {
+	0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+// weights of the Gauss nodes xgk[1], xgk[3], xgk[5] and the centre
+static const double wg[4] = {
+	0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+
+struct Interval{
+	double a, b, value, error;
+};
+
+// Nodes of [a, b]: the centre, then the pairs centre -+ h xgk[j].
+static void nodes(double a, double b, double *x){
+	double c = (a + b) / 2, h = (b - a) / 2;
+	x[0] = c;
+	for (int j = 0; j < 7; j++){
+		x[1 + 2 * j] = c - h * xgk[j];
+		x[2 + 2 * j] = c + h * xgk[j];
+	}
+}
+
+static void rule(Interval &in, const double *y){
+	double h = (in.b - in.a) / 2, fc = y[0];
+	double resk = fc * wgk[7], resg = fc * wg[3], resabs = std::fabs(resk);
+	for (int j = 0; j < 7; j++){
+		double f1 = y[1 + 2 * j], f2 = y[2 + 2 * j];
+		resk += wgk[j] * (f1 + f2);
+		resabs += wgk[j] * (std::fabs(f1) + std::fabs(f2));
+		if (j % 2)
+			resg += wg[j / 2] * (f1 + f2);
+	}
+	double mean = resk / 2, resasc = wgk[7] * std::fabs(fc - mean);
+	for (int j = 0; j < 7; j++)
+		resasc += wgk[j] * (std::fabs(y[1 + 2 * j] - mean) + std::fabs(y[2 + 2 * j] - mean));
+	double err = std::fabs((resk - resg) * h), eps = std::numeric_limits<double>::epsilon();
+	resabs *= std::fabs(h);
+	resasc *= std::fabs(h);
+	if (resasc != 0 && err != 0)
+		err = resasc * std::min(1., std::pow(200 * err / resasc, 1.5));
+	if (resabs > std::numeric_limits<double>::min() / (50 * eps))
+		err = std::max(50 * eps * resabs, err);
+	// a node outside f's domain or at a pole: the sum means nothing, and
+	// bisecting would only find more of them
+	in.value = std::isfinite(resk) ? resk * h : std::numeric_limits<double>::quiet_NaN();
+	in.error = err;
+}
+
+// Applies the rule to every interval of batch, the nodes of each thread's
+// share evaluated in one call.
+static void evaluate(const ExprProgram &f, std::vector<Interval> &batch){
+	int n = batch.size();
+	std::vector<double> x((size_t)n * KRONROD_NODES), y(x.size());
+	for (int i = 0; i < n; i++)
+		nodes(batch[i].a, batch[i].b, &x[(size_t)i * KRONROD_NODES]);
+	parallelFor(0, n, INTEGRATE_GRAIN, [&](int from, int to){
+		f(&x[(size_t)from * KRONROD_NODES], &y[(size_t)from * KRONROD_NODES], (to - from) * KRONROD_NODES);
+		for (int i = from; i < to; i++)
+			rule(batch[i], &y[(size_t)i * KRONROD_NODES]);
+	});
+}
+
+static bool largerError(const Interval &l, const Interval &r){
+	return l.error > r.error;
+}
+
+Quadrature integrate(const ExprProgram &f, double a, double b){
+	Quadrature q = {0, 0, 0, 0, true};
+	if (a == b)
+		return q;
+	std::vector<Interval> all(1, {a, b, 0, 0}), batch = all;
+	evaluate(f, all);
+	q.evaluations = KRONROD_NODES;
+	while (true){
+		q.value = q.error = 0;
+		for (const Interval &in : all){
+			q.value += in.value;
+			q.error += in.error;
+		}
+		q.intervals = all.size();
+		if (std::isnan(q.value) || q.error <= std::max(INTEGRATE_EPSABS, INTEGRATE_EPSREL * std::fabs(q.value)))
+			break;
+		// the intervals to bisect, by decreasing error, move to the front
+		size_t split = std::min(all.size(), (size_t)INTEGRATE_SPLIT);
+		std::partial_sort(all.begin(), all.begin() + split, all.end(), largerError);
+		double worst = all[0].error;
+		batch.clear();
+		size_t k = 0;
+		for (; k < split && all[k].error >= INTEGRATE_SPLIT_RATIO * worst && all.size() + k < INTEGRATE_LIMIT; k++){
+			double c = (all[k].a + all[k].b) / 2;
+			// no room for another bisection in double precision
+			if (c == all[k].a || c == all[k].b)
+				break;
+			batch.push_back({all[k].a, c, 0, 0});
+			batch.push_back({c, all[k].b, 0, 0});
+		}
+		if (batch.empty()){
+			q.converged = false;
+			break;
+		}
+		evaluate(f, batch);
+		q.evaluations += (long long)batch.size() * KRONROD_NODES;
+		all.erase(all.begin(), all.begin() + k);
+		all.insert(all.end(), batch.begin(), batch.end());
+	}
+	return q;
+}
@@ -0,0 +1,131 @@
+#include "Reduce.hpp"
+#include <vector>
+#include "Parallel.hpp"
+
+#define PAIRWISE_BASE 128
+#define REDUCE_BLOCK 16384
+#define REDUCE_GRAIN_BLOCKS 4
+#define REDUCE_GRAIN_ROWS 64
+#define REDUCE_GRAIN_COLS 64
+
+// Sum of f(from) ... f(from + n - 1), halving down to runs of PAIRWISE_BASE
+// that are summed in eight independent lanes; the error grows with log n
+// instead of n.
+template <typename F>
+static double pairwise(const F &f, size_t from, size_t n){
+	if (n <= PAIRWISE_BASE){
+		double s[8] = {0, 0, 0, 0, 0, 0, 0, 0}, r = 0;
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8)
+			for (int k = 0; k < 8; k++)
+				s[k] += f(from + i + k);
+		for (; i < n; i++)
+			r += f(from + i);
+		return ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7])) + r;
+	}
+	size_t half = n / 2 / 8 * 8;
+	return pairwise(f, from, half) + pairwise(f, from + half, n - half);
+}
+
+template <typename F>
+static double extremum(const F &f, size_t from, size_t n, bool max){
+	double r = f(from);
+	for (size_t i = from + 1; i < from + n; i++){
+		double x = f(i);
+		if (max ? x > r : x < r)
+			r = x;
+	}
+	return r;
+}
+
+template <typename F>
+static double run(const F &f, size_t from, size_t n, ReduceOp op){
+	if (op == REDUCE_MIN || op == REDUCE_MAX)
+		return extremum(f, from, n, op == REDUCE_MAX);
+	return pairwise(f, from, n);
+}
+
+// The reductions proper, over value(i, j), the element at row i, column j
+// already transformed (squared deviation, product). With contiguous, rows
+// follow each other in memory and value(0, k) is the k-th element.
+template <typename V>
+static void reduceWith(const V &value, int n, int m, bool contiguous, ReduceOp op, ReduceDim dim, double *out){
+	if (dim == REDUCE_ROWS || (dim == REDUCE_ALL && !contiguous)){
+		std::vector<double> rows(n);
+		double *r = dim == REDUCE_ROWS ? out : rows.data();
+		parallelFor(0, n, REDUCE_GRAIN_ROWS, [&](int from, int to){
+			for (int i = from; i < to; i++)
+				r[i] = run([&](size_t j){ return value(i, j); }, 0, m, op);
+		});
+		if (dim == REDUCE_ALL)
+			out[0] = run([&](size_t i){ return rows[i]; }, 0, n, op);
+	}else if (dim == REDUCE_ALL){
+		size_t total = (size_t)n * m, blocks = (total + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+		std::vector<double> partial(blocks);
+		auto element = [&](size_t k){ return value(0, k); };
+		parallelFor(0, blocks, REDUCE_GRAIN_BLOCKS, [&](int from, int to){
+			for (int b = from; b < to; b++){
+				size_t first = (size_t)b * REDUCE_BLOCK;
+				partial[b] = run(element, first, total - first < REDUCE_BLOCK ? total - first : REDUCE_BLOCK, op);
+			}
+		});
+		out[0] = run([&](size_t b){ return partial[b]; }, 0, blocks, op);
+	}else{
+		// down the columns, a row at a time so that the inner loop is over
+		// adjacent elements; sums carry a Kahan correction per column
+		parallelFor(0, m, REDUCE_GRAIN_COLS, [&](int from, int to){
+			std::vector<double> comp(to - from, 0.);
+			for (int j = from; j < to; j++)
+				out[j] = value(0, j);
+			for (int i = 1; i < n; i++)
+				for (int j = from; j < to; j++){
+					double x = value(i, j);
+					if (op == REDUCE_MIN)
+						out[j] = x < out[j] ? x : out[j];
+					else if (op == REDUCE_MAX)
+						out[j] = x > out[j] ? x : out[j];
+					else{
+						double y = x - comp[j - from], t = out[j] + y;
+						comp[j - from] = (t - out[j]) - y;
+						out[j] = t;
+					}
+				}
+		});
+	}
+}
+
+template <typename T>
+void reduce(const T *a, int n, int m, int ld, ReduceOp op, ReduceDim dim, const double *center, double *out){
+	bool contiguous = ld == m || n == 1;
+	if (op == REDUCE_SQDEV){
+		auto value = [&](int i, size_t j){
+			double d = a[(size_t)i * ld + j] - center[dim == REDUCE_ALL ? 0 : dim == REDUCE_ROWS ? i : j];
+			return d * d;
+		};
+		reduceWith(value, n, m, contiguous, op, dim, out);
+	}else
+		reduceWith([&](int i, size_t j){ return (double)a[(size_t)i * ld + j]; }, n, m, contiguous, op, dim, out);
+}
+
+template <typename T>
+void dot(const T *a, int lda, const T *b, int ldb, int n, int m, ReduceDim dim, double *out){
+	bool contiguous = (lda == m && ldb == m) || n == 1;
+	reduceWith([&](int i, size_t j){ return (double)a[(size_t)i * lda + j] * b[(size_t)i * ldb + j]; },
+			   n, m, contiguous, REDUCE_SUM, dim, out);
+}
+
+void reduceSequence(double start, double step, int n, ReduceOp op, const double *center, double *out){
+	if (op == REDUCE_SQDEV){
+		auto value = [&](int, size_t k){
+			double d = start + k * step - center[0];
+			return d * d;
+		};
+		reduceWith(value, 1, n, true, op, REDUCE_ALL, out);
+	}else
+		reduceWith([&](int, size_t k){ return start + k * step; }, 1, n, true, op, REDUCE_ALL, out);
+}
+
+template void reduce<double>(const double *, int, int, int, ReduceOp, ReduceDim, const double *, double *);
+template void reduce<float>(const float *, int, int, int, ReduceOp, ReduceDim, const double *, double *);
+template void dot<double>(const double *, int, const double *, int, int, int, ReduceDim, double *);
+template void dot<float>(const float *, int, const float *, int, int, int, ReduceDim, double *);
@@ -0,0 +1,148 @@
+#include "Series.hpp"
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include "Parallel.hpp"
+#include "Reduce.hpp"
+
+#define SERIES_BATCH 256
+#define SERIES_BLOCK 16384
+#define SERIES_ROUND 1024LL
+#define SERIES_MAX_EXPONENT 4096LL
+
+// Calls body(y, n) on batches of the values of f at start + k * step for
+// the k of block b, k < count.
+template <typename F>
+static void batches(const ExprProgram &f, double start, double step, long long count, long long b, F body){
+	double x[SERIES_BATCH], y[SERIES_BATCH];
+	long long from = b * SERIES_BLOCK, to = std::min(count, from + SERIES_BLOCK);
+	for (long long k = from; k < to; k += SERIES_BATCH){
+		int n = (int)std::min((long long)SERIES_BATCH, to - k);
+		for (int i = 0; i < n; i++)
+			x[i] = start + (double)(k + i) * step;
+		f(x, y, n);
+		body(y, n);
+	}
+}
+
+// Neumaier's compensated s += y, the lost low-order part kept in c.
+static void compensated(double &s, double &c, double y){
+	double t = s + y;
+	c += std::fabs(s) >= std::fabs(y) ? (s - t) + y : (y - t) + s;
+	s = t;
+}
+
+// Runs block(b) for the blocks 0 .. blocks - 1, SERIES_ROUND of them at a
+// time split across threads, and hands each round's results in order to
+// merge, so that memory stays the same however long the range is.
+template <typename T, typename Block, typename Merge>
+static void rounds(long long blocks, Block block, Merge merge){
+	std::vector<T> part((size_t)std::min(blocks, SERIES_ROUND));
+	for (long long first = 0; first < blocks; first += SERIES_ROUND){
+		int n = (int)std::min(SERIES_ROUND, blocks - first);
+		parallelFor(0, n, 1, [&](int from, int to){
+			for (int b = from; b < to; b++)
+				part[b] = block(first + b);
+		});
+		merge(part.data(), n);
+	}
+}
+
+double seriesSum(const ExprProgram &f, long long first, long long last){
+	if (first > last)
+		return 0;
+	long long count = last - first + 1, blocks = (count - 1) / SERIES_BLOCK + 1;
+	double s = 0, c = 0;
+	rounds<double>(blocks, [&](long long b){
+		double bs = 0, bc = 0;
+		batches(f, (double)first, 1, count, b, [&](const double *y, int n){
+			for (int i = 0; i < n; i++)
+				compensated(bs, bc, y[i]);
+		});
+		return bs + bc;
+	}, [&](const double *part, int n){
+		double r;
+		reduce(part, 1, n, n, REDUCE_SUM, REDUCE_ALL, NULL, &r);
+		compensated(s, c, r);
+	});
+	return s + c;
+}
+
+double seriesProduct(const ExprProgram &f, long long first, long long last){
+	if (first > last)
+		return 1;
+	long long count = last - first + 1, blocks = (count - 1) / SERIES_BLOCK + 1;
+	double m = 1;
+	long long e = 0;
+	rounds<std::pair<double, long long>>(blocks, [&](long long b){
+		double bm = 1;
+		long long be = 0;
+		batches(f, (double)first, 1, count, b, [&](const double *y, int n){
+			for (int i = 0; i < n; i++){
+				int ex;
+				bm = std::frexp(bm * y[i], &ex);
+				be += ex;
+			}
+		});
+		return std::make_pair(bm, be);
+	}, [&](const std::pair<double, long long> *part, int n){
+		for (int b = 0; b < n; b++){
+			int ex;
+			m = std::frexp(m * part[b].first, &ex);
+			e += part[b].second + ex;
+		}
+	});
+	// anything past the double range rounds to infinity or zero alike
+	return std::ldexp(m, (int)std::max(-SERIES_MAX_EXPONENT, std::min(SERIES_MAX_EXPONENT, e)));
+}
+
+double sequenceReduce(const ExprProgram &f, double start, double step, long long count, ReduceOp op, double center){
+	long long blocks = (count - 1) / SERIES_BLOCK + 1;
+	ReduceOp combine = op == REDUCE_SQDEV ? REDUCE_SUM : op;
+	double r = 0, c = 0;
+	bool nan = false, seen = false;
+	rounds<double>(blocks, [&](long long b){
+		std::vector<double> y;
+		batches(f, start, step, count, b, [&](const double *v, int n){
+			y.insert(y.end(), v, v + n);
+		});
+		for (double v : y)
+			if (v != v)
+				return v;
+		double partial;
+		reduce(y.data(), 1, (int)y.size(), (int)y.size(), op, REDUCE_ALL, &center, &partial);
+		return partial;
+	}, [&](const double *part, int n){
+		double p;
+		for (int b = 0; b < n; b++)
+			nan |= part[b] != part[b];
+		reduce(part, 1, n, n, combine, REDUCE_ALL, NULL, &p);
+		if (combine == REDUCE_SUM)
+			compensated(r, c, p);
+		else if (!seen || (op == REDUCE_MIN ? p < r : p > r))
+			r = p;
+		seen = true;
+	});
+	return nan ? std::numeric_limits<double>::quiet_NaN() : r + c;
+}
+
+double polynomialSum(const DensePoly &p, long long first, long long last){
+	if (first > last)
+		return 0;
+	int d = p.degree();
+	std::vector<double> diff(d + 1);
+	for (int i = 0; i <= d; i++){
+		double im;
+		p.eval((double)(first + i), 0, diff[i], im);
+	}
+	double n = (double)(last - first + 1), binom = 1, r = 0;
+	for (int j = 0; j <= d; j++){
+		// binom is C(n, j + 1), diff[0] is D^j p(first)
+		binom = binom * (n - j) / (j + 1);
+		r += diff[0] * binom;
+		for (int i = 0; i < d - j; i++)
+			diff[i] = diff[i + 1] - diff[i];
+	}
+	return r;
+}
@@ -0,0 +1,48 @@
+#include "Tabulate.hpp"
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "Parallel.hpp"
+
+#define TABLE_BATCH 256
+#define TABLE_PIECE 4096
+#define TABLE_PIECES 64
+// "%.15g,%.15g\n" never takes more
+#define TABLE_ROW_CHARS 48
+#define TABLE_DOMAIN_ERROR "Domain error"
+
+bool tabulate(const ExprProgram &f, double from, double step, long long count, std::ostream &out){
+	std::vector<std::string> pieces(TABLE_PIECES);
+	for (long long first = 0; first < count; first += (long long)TABLE_PIECE * TABLE_PIECES){
+		long long left = (count - first + TABLE_PIECE - 1) / TABLE_PIECE;
+		int npieces = left < TABLE_PIECES ? (int)left : TABLE_PIECES;
+		parallelFor(0, npieces, 1, [&](int lo, int hi){
+			double x[TABLE_BATCH], y[TABLE_BATCH];
+			char row[TABLE_ROW_CHARS];
+			for (int p = lo; p < hi; p++){
+				long long start = first + (long long)p * TABLE_PIECE;
+				long long end = start + TABLE_PIECE < count ? start + TABLE_PIECE : count;
+				std::string &s = pieces[p];
+				s.clear();
+				s.reserve((end - start) * TABLE_ROW_CHARS);
+				for (long long k = start; k < end; k += TABLE_BATCH){
+					int n = end - k < TABLE_BATCH ? (int)(end - k) : TABLE_BATCH;
+					for (int i = 0; i < n; i++)
+						x[i] = from + (k + i) * step;
+					f(x, y, n);
+					// where the evaluator would throw, the program gives NaN or inf
+					for (int i = 0; i < n; i++)
+						s.append(row, std::isfinite(y[i]) ? snprintf(row, sizeof(row), "%.15g,%.15g\n", x[i], y[i])
+														  : snprintf(row, sizeof(row), "%.15g," TABLE_DOMAIN_ERROR "\n", x[i]));
+				}
+			}
+		});
+		for (int p = 0; p < npieces; p++)
+			out.write(pieces[p].data(), pieces[p].size());
+		if (!out)
+			return false;
+	}
+	out.flush();
+	return (bool)out;
+}
@@ -0,0 +1,536 @@
+#include "TiledMatrix.hpp"
+#include <list>
+#include <map>
+#include <cstdlib>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Utils.hpp"
+#include "Linalg.hpp"
+#include "Parallel.hpp"
+#include "MatrixFile.hpp"
+
+#define TILE_BYTES ((size_t)TILE * TILE * sizeof(double))
+#define TILE_CACHE_MIN_TILES 4
+#define TILE_GRAIN_ROWS 32
+
+// the limit of the innermost MemoryLimit on this thread
+static thread_local size_t currentLimit = TILED_DEFAULT_MEMORY;
+
+TiledMatrix::MemoryLimit::MemoryLimit(size_t bytes) : saved(currentLimit){
+	currentLimit = bytes;
+}
+
+TiledMatrix::MemoryLimit::~MemoryLimit(){
+	currentLimit = saved;
+}
+
+size_t TiledMatrix::memoryLimit(){
+	return currentLimit;
+}
+
+// Least recently used tiles of every tiled matrix. Tiles still referenced by
+// an operation are never evicted, so the limit can be exceeded by the few
+// tiles a kernel holds at once.
+class TileCache
+{
+public:
+	typedef std::pair<const TiledMatrix *, int> Key;
+
+	std::shared_ptr<TiledMatrix::Tile> get(const TiledMatrix *owner, int index, bool write, bool overwrite){
+		auto it = entries.find(Key(owner, index));
+		if (it != entries.end()){
+			lru.splice(lru.begin(), lru, it->second);
+			if (write)
+				it->second->tile->dirty = true;
+			return it->second->tile;
+		}
+		size_t capacity = TiledMatrix::memoryLimit() / TILE_BYTES;
+		evict(capacity > TILE_CACHE_MIN_TILES ? capacity - 1 : TILE_CACHE_MIN_TILES - 1);
+		std::shared_ptr<TiledMatrix::Tile> tile = std::make_shared<TiledMatrix::Tile>();
+		tile->a.resize((size_t)TILE * TILE, 0.);
+		tile->dirty = write;
+		if (!overwrite)
+			owner->load(index, tile->a.data());
+		lru.push_front({Key(owner, index), tile});
+		entries[Key(owner, index)] = lru.begin();
+		return tile;
+	}
+
+	bool contains(const TiledMatrix *owner, int index) const{
+		return entries.find(Key(owner, index)) != entries.end();
+	}
+
+	// Forgets the tiles of a matrix being destroyed, without writing them.
+	void drop(const TiledMatrix *owner){
+		auto from = entries.lower_bound(Key(owner, 0));
+		auto to = from;
+		for (; to != entries.end() && to->first.first == owner; to++)
+			lru.erase(to->second);
+		entries.erase(from, to);
+	}
+
+private:
+	struct Entry{
+		Key key;
+		std::shared_ptr<TiledMatrix::Tile> tile;
+	};
+
+	void evict(size_t keep){
+		auto it = lru.end();
+		while (entries.size() > keep && it != lru.begin()){
+			it--;
+			if (it->tile.use_count() > 1)
+				continue;
+			if (it->tile->dirty)
+				it->key.first->store(it->key.second, it->tile->a.data());
+			entries.erase(it->key);
+			it = lru.erase(it);
+		}
+	}
+
+	std::list<Entry> lru;
+	std::map<Key, std::list<Entry>::iterator> entries;
+};
+
+static TileCache cache;
+
+TiledMatrix::TiledMatrix(int rows, int cols) : nrows(rows), ncols(cols){
+	const char *dir = getenv("TMPDIR");
+	std::string path = std::string(dir && *dir ? dir : "/tmp") + "/computorv2-tiles-XXXXXX";
+	fd = mkstemp(&path[0]);
+	if (fd < 0)
+		throw MatrixFileError();
+	unlink(path.c_str());
+	if (ftruncate(fd, (off_t)tileRows() * tileCols() * TILE_BYTES) < 0){
+		close(fd);
+		throw MatrixFileError();
+	}
+}
+
+TiledMatrix::~TiledMatrix(){
+	cache.drop(this);
+	close(fd);
+}
+
+int TiledMatrix::rows() const{
+	return nrows;
+}
+
+int TiledMatrix::cols() const{
+	return ncols;
+}
+
+int TiledMatrix::tileRows() const{
+	return (nrows + TILE - 1) / TILE;
+}
+
+int TiledMatrix::tileCols() const{
+	return (ncols + TILE - 1) / TILE;
+}
+
+int TiledMatrix::height(int ti) const{
+	return min(TILE, nrows - ti * TILE);
+}
+
+int TiledMatrix::width(int tj) const{
+	return min(TILE, ncols - tj * TILE);
+}
+
+void TiledMatrix::load(int index, double *a) const{
+	char *p = (char *)a;
+	size_t done = 0;
+	while (done < TILE_BYTES){
+		ssize_t r = pread(fd, p + done, TILE_BYTES - done, (off_t)index * TILE_BYTES + done);
+		if (r < 0)
+			throw MatrixFileError();
+		if (r == 0)
+			break;
+		done += r;
+	}
+}
+
+void TiledMatrix::store(int index, const double *a) const{
+	const char *p = (const char *)a;
+	size_t done = 0;
+	while (done < TILE_BYTES){
+		ssize_t r = pwrite(fd, p + done, TILE_BYTES - done, (off_t)index * TILE_BYTES + done);
+		if (r <= 0)
+			throw MatrixFileError();
+		done += r;
+	}
+}
+
+// write marks the tile dirty; overwrite also skips reading it from disk, for
+// tiles the caller fills completely.
+std::shared_ptr<TiledMatrix::Tile> TiledMatrix::tile(int ti, int tj, bool write, bool overwrite) const{
+	return cache.get(this, ti * tileCols() + tj, write, overwrite);
+}
+
+// Asks the kernel to start reading a tile the next step will need.
+void TiledMatrix::prefetch(int ti, int tj) const{
+	if (ti >= tileRows() || tj >= tileCols() || cache.contains(this, ti * tileCols() + tj))
+		return;
+	posix_fadvise(fd, (off_t)(ti * tileCols() + tj) * TILE_BYTES, TILE_BYTES, POSIX_FADV_WILLNEED);
+}
+
+double TiledMatrix::get(int row, int col) const{
+	return tile(row / TILE, col / TILE)->a[(row % TILE) * TILE + col % TILE];
+}
+
+std::shared_ptr<TiledMatrix> TiledMatrix::fromDense(const double *a, int rows, int cols){
+	std::shared_ptr<TiledMatrix> r = std::make_shared<TiledMatrix>(rows, cols);
+	for (int ti = 0; ti < r->tileRows(); ti++)
+		for (int tj = 0; tj < r->tileCols(); tj++){
+			std::shared_ptr<Tile> t = r->tile(ti, tj, true, true);
+			for (int row = 0; row < r->height(ti); row++)
+				std::copy(a + (size_t)(ti * TILE + row) * cols + tj * TILE,
+						  a + (size_t)(ti * TILE + row) * cols + tj * TILE + r->width(tj),
+						  t->a.data() + row * TILE);
+		}
+	return r;
+}
+
+std::shared_ptr<TiledMatrix> TiledMatrix::generate(int rows, int cols, const Fill &fill){
+	std::shared_ptr<TiledMatrix> r = std::make_shared<TiledMatrix>(rows, cols);
+	for (int ti = 0; ti < r->tileRows(); ti++)
+		for (int tj = 0; tj < r->tileCols(); tj++)
+			fill(ti * TILE, tj * TILE, r->height(ti), r->width(tj), r->tile(ti, tj, true, true)->a.data(), TILE);
+	return r;
+}
+
+// Reads a row-major f64 payload at offset, one tile row segment at a time.
+std::shared_ptr<TiledMatrix> TiledMatrix::fromFile(int fd, off_t offset, int rows, int cols){
+	std::shared_ptr<TiledMatrix> r = std::make_shared<TiledMatrix>(rows, cols);
+	for (int ti = 0; ti < r->tileRows(); ti++)
+		for (int tj = 0; tj < r->tileCols(); tj++){
+			std::shared_ptr<Tile> t = r->tile(ti, tj, true, true);
+			size_t bytes = r->width(tj) * sizeof(double);
+			for (int row = 0; row < r->height(ti); row++){
+				off_t at = offset + ((off_t)(ti * TILE + row) * cols + tj * TILE) * sizeof(double);
+				if (pread(fd, t->a.data() + row * TILE, bytes, at) != (ssize_t)bytes)
+					throw MatrixFileError();
+			}
+		}
+	return r;
+}
+
+void TiledMatrix::toDense(double *a) const{
+	block(0, 0, nrows, ncols, a);
+}
+
+// Copies rows [row, row + nrows) and columns [col, col + ncols) into a dense
+// row-major array, reading only the tiles that overlap them.
+void TiledMatrix::block(int row, int col, int nrows, int ncols, double *a) const{
+	for (int ti = row / TILE; ti <= (row + nrows - 1) / TILE; ti++)
+		for (int tj = col / TILE; tj <= (col + ncols - 1) / TILE; tj++){
+			std::shared_ptr<Tile> t = tile(ti, tj);
+			int r0 = max(row, ti * TILE), r1 = min(row + nrows, ti * TILE + height(ti));
+			int c0 = max(col, tj * TILE), c1 = min(col + ncols, tj * TILE + width(tj));
+			for (int r = r0; r < r1; r++){
+				const double *src = t->a.data() + (r - ti * TILE) * TILE;
+				std::copy(src + c0 - tj * TILE, src + c1 - tj * TILE, a + (size_t)(r - row) * ncols + c0 - col);
+			}
+		}
+}
+
+void TiledMatrix::toFile(int out, off_t offset) const{
+	for (int ti = 0; ti < tileRows(); ti++)
+		for (int tj = 0; tj < tileCols(); tj++){
+			std::shared_ptr<Tile> t = tile(ti, tj);
+			size_t bytes = width(tj) * sizeof(double);
+			for (int row = 0; row < height(ti); row++){
+				off_t at = offset + ((off_t)(ti * TILE + row) * ncols + tj * TILE) * sizeof(double);
+				if (pwrite(out, t->a.data() + row * TILE, bytes, at) != (ssize_t)bytes)
+					throw MatrixFileError();
+			}
+		}
+}
+
+std::shared_ptr<TiledMatrix> TiledMatrix::copy() const{
+	std::shared_ptr<TiledMatrix> r = std::make_shared<TiledMatrix>(nrows, ncols);
+	for (int ti = 0; ti < tileRows(); ti++)
+		for (int tj = 0; tj < tileCols(); tj++){
+			prefetch(ti, tj + 1);
+			r->tile(ti, tj, true, true)->a = tile(ti, tj)->a;
+		}
+	return r;
+}
+
+// Padding outside the matrix stays zero, so that whole tiles can be fed to
+// the product kernels.
+std::shared_ptr<TiledMatrix> TiledMatrix::elementwise(const TiledMatrix &rhs, char opcode) const{
+	std::shared_ptr<TiledMatrix> r = std::make_shared<TiledMatrix>(nrows, ncols);
+	for (int ti = 0; ti < tileRows(); ti++)
+		for (int tj = 0; tj < tileCols(); tj++){
+			prefetch(ti, tj + 1);
+			rhs.prefetch(ti, tj + 1);
+			std::shared_ptr<Tile> x = tile(ti, tj), y = rhs.tile(ti, tj), t = r->tile(ti, tj, true, true);
+			for (int row = 0; row < height(ti); row++){
+				const double *p = x->a.data() + row * TILE, *q = y->a.data() + row * TILE;
+				double *out = t->a.data() + row * TILE;
+				for (int col = 0; col < width(tj); col++)
+					out[col] = opcode == '+' ? p[col] + q[col] : opcode == '-' ? p[col] - q[col]
+							 : opcode == '*' ? p[col] * q[col] : p[col] / q[col];
+			}
+		}
+	return r;
+}
+
+std::shared_ptr<TiledMatrix> TiledMatrix::scalarOp(double s, char opcode) const{
+	std::shared_ptr<TiledMatrix> r = std::make_shared<TiledMatrix>(nrows, ncols);
+	for (int ti = 0; ti < tileRows(); ti++)
+		for (int tj = 0; tj < tileCols(); tj++){
+			prefetch(ti, tj + 1);
+			std::shared_ptr<Tile> x = tile(ti, tj), t = r->tile(ti, tj, true, true);
+			for (int row = 0; row < height(ti); row++)
+				for (int col = 0; col < width(tj); col++)
+					t->a[row * TILE + col] = opcode == '*' ? x->a[row * TILE + col] * s : x->a[row * TILE + col] / s;
+		}
+	return r;
+}
+
+// c += sign * a b for rows [0, h) of TILE x TILE tiles; a's columns past k
+// are not read.
+void tileGemm(double *c, const double *a, const double *b, int h, int k, double sign){
+	parallelFor(0, h, TILE_GRAIN_ROWS, [&](int from, int to){
+		for (int i = from; i < to; i++){
+			double *ci = c + i * TILE;
+			for (int q = 0; q < k; q++){
+				double aiq = sign * a[i * TILE + q];
+				if (aiq == 0)
+					continue;
+				const double *bq = b + q * TILE;
+				for (int j = 0; j < TILE; j++)
+					ci[j] += aiq * bq[j];
+			}
+		}
+	});
+}
+
+// Each output tile is accumulated in memory over one row of tiles of this
+// and one column of rhs, the next pair being prefetched meanwhile.
+std::shared_ptr<TiledMatrix> TiledMatrix::multiply(const TiledMatrix &rhs) const{
+	std::shared_ptr<TiledMatrix> r = std::make_shared<TiledMatrix>(nrows, rhs.ncols);
+	std::vector<double> acc((size_t)TILE * TILE);
+	for (int ti = 0; ti < r->tileRows(); ti++)
+		for (int tj = 0; tj < r->tileCols(); tj++){
+			std::fill(acc.begin(), acc.end(), 0.);
+			for (int k = 0; k < tileCols(); k++){
+				prefetch(ti, k + 1);
+				rhs.prefetch(k + 1, tj);
+				tileGemm(acc.data(), tile(ti, k)->a.data(), rhs.tile(k, tj)->a.data(), TILE, TILE, 1);
+			}
+			r->tile(ti, tj, true, true)->a.swap(acc);
+			acc.resize((size_t)TILE * TILE);
+		}
+	return r;
+}
+
+std::shared_ptr<TiledMatrix> TiledMatrix::transpose() const{
+	std::shared_ptr<TiledMatrix> r = std::make_shared<TiledMatrix>(ncols, nrows);
+	for (int ti = 0; ti < tileRows(); ti++)
+		for (int tj = 0; tj < tileCols(); tj++){
+			prefetch(ti, tj + 1);
+			std::shared_ptr<Tile> x = tile(ti, tj), t = r->tile(tj, ti, true, true);
+			for (int row = 0; row < TILE; row++)
+				for (int col = 0; col < TILE; col++)
+					t->a[col * TILE + row] = x->a[row * TILE + col];
+		}
+	return r;
+}
+
+double TiledMatrix::norm1() const{
+	std::vector<double> colsum(ncols, 0.);
+	for (int ti = 0; ti < tileRows(); ti++)
+		for (int tj = 0; tj < tileCols(); tj++){
+			prefetch(ti, tj + 1);
+			std::shared_ptr<Tile> x = tile(ti, tj);
+			for (int row = 0; row < height(ti); row++)
+				for (int col = 0; col < width(tj); col++)
+					colsum[tj * TILE + col] += abs(x->a[row * TILE + col]);
+		}
+	double r = 0;
+	for (double s : colsum)
+		if (s > r)
+			r = s;
+	return r;
+}
+
+// Right-looking LU with partial pivoting, in place, one column of tiles at a
+// time: the column is factored in memory (it is the only part of the matrix
+// that has to be resident), its row swaps are applied to the other columns,
+// then the row of U is solved and the trailing tiles updated. piv[g] is the
+// row swapped with row g, as in LAPACK. Returns false if singular.
+bool TiledMatrix::factor(std::vector<int> &piv){
+	int n = nrows, nt = tileRows();
+	piv.resize(n);
+	std::vector<double> panel;
+	for (int k = 0; k < nt; k++){
+		int w = width(k), top = k * TILE, m = n - top;
+		panel.assign((size_t)m * TILE, 0.);
+		auto P = [&panel](int r, int c) -> double & { return panel[(size_t)r * TILE + c]; };
+		for (int i = k; i < nt; i++){
+			std::shared_ptr<Tile> t = tile(i, k);
+			std::copy(t->a.begin(), t->a.begin() + height(i) * TILE, panel.begin() + (size_t)(i - k) * TILE * TILE);
+		}
+		for (int j = 0; j < w; j++){
+			int p = j;
+			for (int r = j + 1; r < m; r++)
+				if (abs(P(r, j)) > abs(P(p, j)))
+					p = r;
+			piv[top + j] = top + p;
+			if (P(p, j) == 0)
+				return false;
+			if (p != j)
+				std::swap_ranges(&P(j, 0), &P(j, 0) + w, &P(p, 0));
+			for (int r = j + 1; r < m; r++){
+				double l = P(r, j) /= P(j, j);
+				if (l != 0)
+					for (int c = j + 1; c < w; c++)
+						P(r, c) -= l * P(j, c);
+			}
+		}
+		for (int i = k; i < nt; i++){
+			std::shared_ptr<Tile> t = tile(i, k, true, true);
+			std::copy(panel.begin() + (size_t)(i - k) * TILE * TILE,
+					  panel.begin() + (size_t)(i - k) * TILE * TILE + height(i) * TILE, t->a.begin());
+		}
+		for (int c = 0; c < nt; c++){
+			if (c == k)
+				continue;
+			for (int j = 0; j < w; j++){
+				int g = top + j, p = piv[g];
+				if (p == g)
+					continue;
+				std::shared_ptr<Tile> t1 = tile(g / TILE, c, true), t2 = tile(p / TILE, c, true);
+				std::swap_ranges(t1->a.begin() + (g % TILE) * TILE, t1->a.begin() + (g % TILE + 1) * TILE,
+								 t2->a.begin() + (p % TILE) * TILE);
+			}
+		}
+		for (int c = k + 1; c < nt; c++){
+			std::shared_ptr<Tile> u = tile(k, c, true);
+			for (int r = 1; r < w; r++)
+				for (int q = 0; q < r; q++)
+					if (P(r, q) != 0)
+						for (int col = 0; col < TILE; col++)
+							u->a[r * TILE + col] -= P(r, q) * u->a[q * TILE + col];
+			for (int i = k + 1; i < nt; i++){
+				prefetch(i + 1, c);
+				tileGemm(tile(i, c, true)->a.data(), &P((i - k) * TILE, 0), u->a.data(), height(i), w, -1);
+			}
+		}
+	}
+	return true;
+}
+
+// Solves A x = b (or A^T x = b) for n x nrhs b in place, given the factors
+// and pivots left by factor().
+void TiledMatrix::luSolve(const std::vector<int> &piv, double *b, int nrhs, bool trans) const{
+	int n = nrows, nt = tileRows();
+	auto B = [b, nrhs](int row) { return b + (size_t)row * nrhs; };
+	// b[dst] -= sum over q < k of x(r, q) * b[src + q], for the rows r of a block
+	auto update = [&](int dst, int h, int src, int k, const std::function<double(int, int)> &x){
+		for (int r = 0; r < h; r++)
+			for (int q = 0; q < k; q++){
+				double f = x(r, q);
+				if (f != 0)
+					for (int c = 0; c < nrhs; c++)
+						B(dst + r)[c] -= f * B(src + q)[c];
+			}
+	};
+	if (!trans){
+		for (int g = 0; g < n; g++)
+			if (piv[g] != g)
+				std::swap_ranges(B(g), B(g) + nrhs, B(piv[g]));
+		for (int k = 0; k < nt; k++){
+			int w = width(k), top = k * TILE;
+			std::shared_ptr<Tile> d = tile(k, k);
+			for (int r = 1; r < w; r++)
+				update(top + r, 1, top, r, [&](int, int q){ return d->a[r * TILE + q]; });
+			for (int i = k + 1; i < nt; i++){
+				prefetch(i + 1, k);
+				std::shared_ptr<Tile> l = tile(i, k);
+				update(i * TILE, height(i), top, w, [&](int r, int q){ return l->a[r * TILE + q]; });
+			}
+		}
+		for (int k = nt - 1; k >= 0; k--){
+			int w = width(k), top = k * TILE;
+			std::shared_ptr<Tile> d = tile(k, k);
+			for (int r = w - 1; r >= 0; r--){
+				for (int q = r + 1; q < w; q++)
+					for (int c = 0; c < nrhs; c++)
+						B(top + r)[c] -= d->a[r * TILE + q] * B(top + q)[c];
+				for (int c = 0; c < nrhs; c++)
+					B(top + r)[c] /= d->a[r * TILE + r];
+			}
+			for (int i = 0; i < k; i++){
+				std::shared_ptr<Tile> u = tile(i, k);
+				update(i * TILE, TILE, top, w, [&](int r, int q){ return u->a[r * TILE + q]; });
+			}
+		}
+		return;
+	}
+	// A^T = U^T L^T P: forward with U^T, backward with L^T, then undo the swaps
+	for (int k = 0; k < nt; k++){
+		int w = width(k), top = k * TILE;
+		std::shared_ptr<Tile> d = tile(k, k);
+		for (int r = 0; r < w; r++){
+			for (int q = 0; q < r; q++)
+				for (int c = 0; c < nrhs; c++)
+					B(top + r)[c] -= d->a[q * TILE + r] * B(top + q)[c];
+			for (int c = 0; c < nrhs; c++)
+				B(top + r)[c] /= d->a[r * TILE + r];
+		}
+		for (int i = k + 1; i < nt; i++){
+			prefetch(k, i + 1);
+			std::shared_ptr<Tile> u = tile(k, i);
+			update(i * TILE, width(i), top, w, [&](int r, int q){ return u->a[q * TILE + r]; });
+		}
+	}
+	for (int k = nt - 1; k >= 0; k--){
+		int w = width(k), top = k * TILE;
+		std::shared_ptr<Tile> d = tile(k, k);
+		for (int r = w - 2; r >= 0; r--)
+			for (int q = r + 1; q < w; q++)
+				for (int c = 0; c < nrhs; c++)
+					B(top + r)[c] -= d->a[q * TILE + r] * B(top + q)[c];
+		for (int i = 0; i < k; i++){
+			std::shared_ptr<Tile> l = tile(k, i);
+			update(i * TILE, TILE, top, height(k), [&](int r, int q){ return l->a[q * TILE + r]; });
+		}
+	}
+	for (int g = n - 1; g >= 0; g--)
+		if (piv[g] != g)
+			std::swap_ranges(B(g), B(g) + nrhs, B(piv[g]));
+}
+
+double TiledMatrix::det() const{
+	std::shared_ptr<TiledMatrix> f = copy();
+	std::vector<int> piv;
+	if (!f->factor(piv))
+		return 0;
+	double d = 1;
+	for (int k = 0; k < tileRows(); k++){
+		std::shared_ptr<Tile> t = f->tile(k, k);
+		for (int j = 0; j < width(k); j++)
+			d *= t->a[j * TILE + j];
+	}
+	for (int g = 0; g < nrows; g++)
+		if (piv[g] != g)
+			d = -d;
+	return d;
+}
+
+// Solves this * x = b for n x nrhs b in place; rcond receives the reciprocal
+// 1-norm condition number estimate. Returns false if singular.
+bool TiledMatrix::solve(double *b, int nrhs, double &rcond) const{
+	double anorm = norm1();
+	std::shared_ptr<TiledMatrix> f = copy();
+	std::vector<int> piv;
+	if (!f->factor(piv))
+		return false;
+	f->luSolve(piv, b, nrhs, false);
+	rcond = 1 / (anorm * invNorm1(nrows, [&](double *x, bool trans){ f->luSolve(piv, x, 1, trans); }));
+	return true;
+}
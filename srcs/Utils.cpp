@@ -1,5 +1,10 @@
 #include "Utils.hpp"
 #include <iomanip>
+#include <cstring>
+#include <cstdint>
+
+#define LN2_HI 6.93147180369123816490e-01
+#define LN2_LO 1.90821492927058770002e-10
 
 const char *DomainError::what() const throw()
 {
@@ -42,31 +47,81 @@ double abs(double x){
 	return x < 0 ? -x : x;
 }
 
+// 2^k for the exponents of normal doubles, -1022 <= k <= 1023.
+static double pow2(int k){
+	uint64_t bits = (uint64_t)(k + 1023) << 52;
+	double r;
+	memcpy(&r, &bits, sizeof(r));
+	return r;
+}
+
+static double scale2(double x, int k){
+	for (; k > 1023; k -= 1023)
+		x *= pow2(1023);
+	for (; k < -1022; k += 1022)
+		x *= pow2(-1022);
+	return x * pow2(k);
+}
+
+// x = m 2^e with m in [1, 2), for finite x > 0.
+static double mantissa(double x, int &e){
+	e = 0;
+	if (x < pow2(-1022)){
+		x *= pow2(54);
+		e = -54;
+	}
+	uint64_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	e += (int)(bits >> 52) - 1023;
+	bits = (bits & ((1ull << 52) - 1)) | (1023ull << 52);
+	memcpy(&x, &bits, sizeof(x));
+	return x;
+}
+
+// exp(x) = 2^k exp(r) with |r| <= ln(2) / 2, where the series takes a
+// dozen terms; ln(2) is split in two so that k ln(2) is exact.
 double exp(double x){
-	double r = 1;
+	if (x != x)
+		return x;
+	if (x > 710)
+		return 1. / 0.;
+	if (x < -746)
+		return 0;
+	int k = (int)(x / (LN2_HI + LN2_LO) + (x < 0 ? -0.5 : 0.5));
+	double r = (x - k * LN2_HI) - k * LN2_LO;
+	double sum = 1;
 	double delta = 1;
-	for (int n = 1; r + delta != r; n++){
-		delta *= x / n;
-		r += delta;
+	for (int n = 1; sum + delta != sum; n++){
+		delta *= r / n;
+		sum += delta;
 	}
-	return r;
+	return scale2(sum, k);
 }
 
+// ln(x) = e ln(2) + ln(m) for x = m 2^e with m in [sqrt(2) / 2, sqrt(2)), and
+// ln(m) = 2 atanh(s) for s = (m - 1) / (m + 1), |s| < 0.18: a series in s^2
+// that converges within a dozen terms for any x.
 double ln(double x){
-	if(0<x && x<=1){
-		x -= 1;
-		double r = x;
-		double xpwr = x;
-		double delta = 1;
-		for (int n = 2; r + delta != r; n++){
-			xpwr *= -x;
-			delta = xpwr / n;
-			r += delta;
-		}
-		return r;
-	}else if(x>1)
-		return -ln(1 / x);
-	throw DomainError();
+	if (!(x > 0))
+		throw DomainError();
+	if (x == 1. / 0.)
+		return x;
+	int e;
+	double m = mantissa(x, e);
+	if (m >= FT_SQRT2){
+		m /= 2;
+		e++;
+	}
+	double s = (m - 1) / (m + 1), s2 = s * s;
+	double r = s;
+	double spwr = s;
+	double delta = 1;
+	for (int n = 3; r + delta != r; n += 2){
+		spwr *= s2;
+		delta = spwr / n;
+		r += delta;
+	}
+	return 2 * r + e * LN2_LO + e * LN2_HI;
 }
 
 double reduce_period(double x, double t){
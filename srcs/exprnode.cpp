@@ -47,6 +47,19 @@ exprnode *exprnode::clone() const{
 		varname);
 }
 
+int precedence(char opcode)
+{
+	if (contains("+-", opcode))
+		return 1;
+	if (contains("*/%m", opcode))
+		return 2;
+	if (opcode == '^')
+		return 3;
+	if (opcode == '[')
+		return 4;
+	return 0;
+}
+
 void recprint(const exprnode *root, std::stringstream &ss, char parOpCode, bool right)
 {
 	(void)parOpCode;
@@ -69,14 +82,41 @@ void recprint(const exprnode *root, std::stringstream &ss, char parOpCode, bool
 	}
 	else if (root->opcode == 'v')
 		ss << root->varname;
-	else {
-		bool par = (contains("*/%^m", parOpCode) && contains("+-", root->opcode)) ||
-				   (right && parOpCode == '-' && root->opcode == '+');
+	else if (root->opcode == 's')
+		ss << '"' << root->varname << '"';
+	else if (root->opcode == '['){
+		recprint(root->left, ss, root->opcode, false);
+		ss << "[";
+		recprint(root->right, ss, 0, false);
+		ss << "]";
+	}else if (root->opcode == ':'){
+		recprint(root->left, ss, 0, false);
+		ss << ":";
+		recprint(root->right, ss, 0, true);
+	}else if (root->opcode == 'r'){
+		bool par = precedence(parOpCode) > 0;
+		ss << (par ? "(" : "");
+		recprint(root->left, ss, root->opcode, false);
+		ss << ":";
+		recprint(root->right, ss, root->opcode, true);
+		ss << (par ? ")" : "");
+	}else if (root->opcode == ','){
+		recprint(root->left, ss, root->opcode, false);
+		ss << ", ";
+		recprint(root->right, ss, root->opcode, true);
+	}else {
+		int prec = precedence(root->opcode), parprec = precedence(parOpCode);
+		bool par = prec < parprec ||
+				   (prec == parprec && right && contains("-/%", parOpCode)) ||
+				   (prec == parprec && !right && parOpCode == '^');
 		ss << (par ? "(" : "");
 		recprint(root->left, ss, root->opcode, false);
 		if (root->opcode != '^')
 			ss << " ";
-		ss << root->opcode;
+		if (root->opcode == 'm')
+			ss << "**";
+		else
+			ss << root->opcode;
 		if (root->opcode != '^')
 			ss << " ";
 		recprint(root->right, ss, root->opcode, true);